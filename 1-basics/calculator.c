@@ -1,34 +1,1285 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+// Size of the chunks stdin is read in
+#define READ_CHUNK_SZ (1 << 20)
+
+// Results are written out once this many bytes are collected
+#define OUTPUT_FLUSH_SZ (1 << 20)
+
+// Amount of pairs that are calculated together
+#define BLOCK_SZ 4096
+
+// Longest line one pair can produce, four lines of two operands and a result,
+// plus room for the fixed size copies of the operands that run past the end
+#define MAX_PAIR_OUTPUT 192
+
+// Operands are copied as text in pieces of this size, the bytes after the end are overwritten later
+#define OPERAND_TEXT_SZ 16
+
+// Room for "a?b=" of a pair, the second operand is copied whole right after the first one
+#define OPERANDS_TEXT_SZ (2 * OPERAND_TEXT_SZ)
+
+// The parser looks for the starts of numbers in windows of this many bytes at once, one bit per byte
+#define PARSE_WINDOW_SZ 64
+
+// Bytes after the end of a chunk that can be read by a whole window or when copying a whole operand slot
+#define READ_CHUNK_SLACK PARSE_WINDOW_SZ
+
+// Longest number in the input of the expression mode that is still read, with all its digits
+#define MAX_NUMBER_TEXT_SZ 512
+
+// Longest line of an expression result, the largest double has 309 digits before the two decimals
+#define MAX_DECIMAL_OUTPUT 320
+
+typedef struct {
+	char *data;
+	size_t length;
+	int fd;
+} OutputBuffer;
+
+// The results of a whole block of pairs, each column calculated in its own loop
+typedef struct {
+	int a[BLOCK_SZ];
+	int b[BLOCK_SZ];
+	// "a?b=" which starts every line of a pair, put together by the parser so the operands are never turned
+	// into text again. The ? is where each line puts its operator.
+	char operands[BLOCK_SZ][OPERANDS_TEXT_SZ];
+	unsigned char aLength[BLOCK_SZ];
+	unsigned char operandsLength[BLOCK_SZ];
+	long long sum[BLOCK_SZ];
+	long long difference[BLOCK_SZ];
+	long long product[BLOCK_SZ];
+	// Only the size of the quotient, the sign follows from the operands
+	long long quotient[BLOCK_SZ];
+	size_t count;
+} Block;
+
+// Everything the batch mode keeps between chunks of input
+typedef struct {
+	Block *block;
+	OutputBuffer buffer;
+	// The first number of a pair waits in the next free place of the block
+	int hasPendingA;
+	long pairs;
+} BatchState;
+
+// Divide a by b and round to two decimals, an exact half to the even neighbour like printf does.
+// Returns the size of the quotient times 100, b must not be 0.
+long long getQuotientHundredths(int a, int b) {
+	long long numerator = llabs((long long)a * 100);
+	long long divisor = llabs(b);
+	long long hundredths = numerator / divisor;
+	long long doubledRemainder = numerator % divisor * 2;
+
+	// Round up past the half, or at exactly the half when that makes the last digit even
+	return hundredths + ((doubledRemainder > divisor) | ((doubledRemainder == divisor) & hundredths));
+}
 
 void printSum(int a, int b) {
-	int sum = a + b;
-	// %d is used to print an integer
-	printf("%d+%d=%d\n", a, b, sum);
+	// Use a long long so adding two large ints can't overflow
+	long long sum = (long long)a + b;
+	// %d is used to print an integer, %lld for a long long
+	printf("%d+%d=%lld\n", a, b, sum);
 }
 
 void printDifference(int a, int b) {
-	int difference = a - b;
-	printf("%d-%d=%d\n", a, b, difference);
+	long long difference = (long long)a - b;
+	printf("%d-%d=%lld\n", a, b, difference);
 }
 
 void printProduct(int a, int b) {
-	int product = a * b;
-	printf("%d*%d=%d\n", a, b, product);
+	long long product = (long long)a * b;
+	printf("%d*%d=%lld\n", a, b, product);
 }
 
 void printQuotient(int a, int b) {
-	// We need to cast a to float to get a float result
-	float quotient = (float)a / b;
-	// %f is used to print a float
-	// %.2f is used to print a float with 2 decimal places
-	printf("%d/%d=%.2f\n", a, b, quotient);
+	// Dividing by zero has no result
+	if (b == 0) {
+		printf("%d/%d=undefined\n", a, b);
+		return;
+	}
+
+	// Calculate with integers, a float can't even hold every int exactly
+	long long hundredths = getQuotientHundredths(a, b);
+	const char *sign = (a < 0) != (b < 0) && a != 0 ? "-" : "";
+	// %02lld pads the decimals with a zero to always print 2 decimal places
+	printf("%d/%d=%s%lld.%02lld\n", a, b, sign, hundredths / 100, hundredths % 100);
+}
+
+double getMonotonicSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void writeAll(int fd, const char *data, size_t length) {
+	while (length > 0) {
+		ssize_t written = write(fd, data, length);
+		if (written < 0) {
+			perror("write");
+			exit(EXIT_FAILURE);
+		}
+		data += written;
+		length -= written;
+	}
+}
+
+void flushOutputBuffer(OutputBuffer *buffer) {
+	writeAll(buffer->fd, buffer->data, buffer->length);
+	buffer->length = 0;
+}
+
+// The 4 digits of every number below 10000 with leading zeros, filled in by initDigitTable
+unsigned int fourDigits[10000];
+
+// Amount of decimal digits of a number
+int countDigits(unsigned long long value) {
+	static const unsigned long long powersOfTen[] = {
+		1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+		1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+		100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+		1000000000000000000ULL, 10000000000000000000ULL};
+
+	// Every bit is about 0.3 digits (1233 / 4096), so the highest bit gives a guess that is at most one too low
+	value |= 1;
+	int guess = (64 - __builtin_clzll(value)) * 1233 >> 12;
+	return guess + (value >= powersOfTen[guess]);
+}
+
+// Read 8 bytes as one number, the first byte in memory is always the lowest one
+unsigned long long loadEightBytes(const char *in) {
+	unsigned long long bytes;
+	memcpy(&bytes, in, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	bytes = __builtin_bswap64(bytes);
+#endif
+	return bytes;
+}
+
+void storeEightBytes(char *out, unsigned long long bytes) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	bytes = __builtin_bswap64(bytes);
+#endif
+	memcpy(out, &bytes, 8);
+}
+
+void initDigitTable() {
+	for (int i = 0; i < 10000; i++) {
+		char digits[4] = {'0' + i / 1000, '0' + i / 100 % 10, '0' + i / 10 % 10, '0' + i % 10};
+		memcpy(&fourDigits[i], digits, 4);
+	}
+}
+
+// Turn a number below 100000000 into its 8 digits with leading zeros, the first digit in the lowest byte
+unsigned long long getEightDigits(unsigned int value) {
+	// The table holds the digits in memory order, so load them the same way as text
+	char digits[8];
+	memcpy(digits, &fourDigits[value / 10000], 4);
+	memcpy(digits + 4, &fourDigits[value % 10000], 4);
+	return loadEightBytes(digits);
+}
+
+// Write the last count of the 8 digits, always storing 8 bytes
+void writeDigits(char *out, unsigned long long digits, int count) {
+	storeEightBytes(out, digits >> (8 - count) * 8);
+}
+
+// Write a number without printf 8 digits at a time, returns the amount of characters written.
+// Up to 8 bytes after the number are overwritten, the caller must have room for that.
+size_t formatNumber(char *out, long long value) {
+	unsigned long long magnitude = value < 0 ? -(unsigned long long)value : (unsigned long long)value;
+	int digits = countDigits(magnitude);
+
+	out[0] = '-';
+	out += value < 0;
+
+	// Only the first group can be shorter than 8 digits, the ones after it are written whole
+	if (digits <= 16) {
+		// Both groups are always made, so nothing depends on a guess whether the number has more than 8 digits.
+		// With 8 or fewer the low group comes first, and the second write only leaves extra bytes after the end.
+		unsigned long long high = getEightDigits(magnitude / 100000000);
+		unsigned long long low = getEightDigits(magnitude % 100000000);
+		int isLong = digits > 8;
+		int firstCount = isLong ? digits - 8 : digits;
+		writeDigits(out, isLong ? high : low, firstCount);
+		writeDigits(out + firstCount, low, 8);
+	} else {
+		writeDigits(out, getEightDigits(magnitude / 10000000000000000ULL), digits - 16);
+		writeDigits(out + digits - 16, getEightDigits(magnitude / 100000000 % 100000000), 8);
+		writeDigits(out + digits - 8, getEightDigits(magnitude % 100000000), 8);
+	}
+
+	return digits + (value < 0);
+}
+
+// Calculate all four results for the block. The loops have no branches, so the compiler can vectorize them.
+void calculateBlock(Block *block) {
+	size_t count = block->count;
+
+	for (size_t i = 0; i < count; i++) {
+		block->sum[i] = (long long)block->a[i] + block->b[i];
+	}
+	for (size_t i = 0; i < count; i++) {
+		block->difference[i] = (long long)block->a[i] - block->b[i];
+	}
+	for (size_t i = 0; i < count; i++) {
+		block->product[i] = (long long)block->a[i] * block->b[i];
+	}
+	for (size_t i = 0; i < count; i++) {
+		// Divide by 1 instead of 0, the result isn't printed anyway
+		block->quotient[i] = getQuotientHundredths(block->a[i], block->b[i] | (block->b[i] == 0));
+	}
+}
+
+// Write the same lines as the print functions for every pair in the block
+void formatBlock(OutputBuffer *buffer, const Block *block) {
+	for (size_t i = 0; i < block->count; i++) {
+		if (buffer->length + MAX_PAIR_OUTPUT > OUTPUT_FLUSH_SZ) {
+			flushOutputBuffer(buffer);
+		}
+
+		int a = block->a[i], b = block->b[i];
+		char *out = buffer->data + buffer->length;
+
+		// Every line starts with the same operands and only changes the operator.
+		// Copying the whole slot is a few fixed size moves, the bytes after the end are overwritten later.
+		const char *prefix = block->operands[i];
+		size_t aLength = block->aLength[i];
+		size_t prefixLength = block->operandsLength[i];
+
+		memcpy(out, prefix, OPERANDS_TEXT_SZ);
+		out[aLength] = '+';
+		out += prefixLength;
+		out += formatNumber(out, block->sum[i]);
+		*out++ = '\n';
+
+		memcpy(out, prefix, OPERANDS_TEXT_SZ);
+		out[aLength] = '-';
+		out += prefixLength;
+		out += formatNumber(out, block->difference[i]);
+		*out++ = '\n';
+
+		memcpy(out, prefix, OPERANDS_TEXT_SZ);
+		out[aLength] = '*';
+		out += prefixLength;
+		out += formatNumber(out, block->product[i]);
+		*out++ = '\n';
+
+		memcpy(out, prefix, OPERANDS_TEXT_SZ);
+		out[aLength] = '/';
+		out += prefixLength;
+		if (b == 0) {
+			memcpy(out, "undefined", 9);
+			out += 9;
+		} else {
+			long long hundredths = block->quotient[i];
+			*out = '-';
+			out += ((a < 0) != (b < 0)) & (a != 0);
+			out += formatNumber(out, hundredths / 100);
+			*out++ = '.';
+			// The last two of the 4 digits in the table are the decimals
+			memcpy(out, (const char *)&fourDigits[hundredths % 100] + 2, 2);
+			out += 2;
+		}
+		*out++ = '\n';
+
+		buffer->length = out - buffer->data;
+	}
+}
+
+// Amount of digits at the start of 8 bytes of text
+int countLeadingDigits(unsigned long long bytes) {
+	// A byte is a digit if its high half is 3 and adding 6 to it keeps the high half at 3, so from '0' up to '9'.
+	// Putting both high halves next to each other makes every digit 0x33, and the XOR turns those into 0.
+	unsigned long long highHalves = bytes & 0xF0F0F0F0F0F0F0F0ULL;
+	unsigned long long shiftedHalves = (bytes + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL;
+	unsigned long long nonDigits = (highHalves | shiftedHalves >> 4) ^ 0x3333333333333333ULL;
+
+	// The first byte that isn't a digit is the lowest one that isn't 0
+	return nonDigits == 0 ? 8 : __builtin_ctzll(nonDigits) / 8;
+}
+
+// Amount of '0' characters at the start of the text, at most up to end
+long countLeadingZeros(const char *text, const char *end) {
+	const char *cursor = text;
+	for (;;) {
+		// Every '0' becomes a zero byte, the first one that isn't is the lowest one that isn't 0
+		unsigned long long others = loadEightBytes(cursor) ^ 0x3030303030303030ULL;
+		int zeros = others == 0 ? 8 : __builtin_ctzll(others) / 8;
+		if (zeros > end - cursor) {
+			return end - text;
+		}
+		cursor += zeros;
+		if (zeros < 8) {
+			return cursor - text;
+		}
+	}
+}
+
+// Turn the first count digits of 8 bytes of text into a number, count must be between 0 and 8
+long long parseEightDigits(unsigned long long bytes, int count) {
+	// Move the digits to the end, the empty bytes in front become leading zeros.
+	// Shifting by 64 isn't allowed in C, so shift in two halves for when there are no digits at all.
+	int shift = (8 - count) * 4;
+	unsigned long long digits = (bytes - 0x3030303030303030ULL) << shift << shift;
+
+	// Combine neighbours into pairs, then pairs into groups of 4, then the two groups, each time for all of them at once
+	digits = (digits * 10 + (digits >> 8)) & 0x00FF00FF00FF00FFULL;
+	digits = (digits * 100 + (digits >> 16)) & 0x0000FFFF0000FFFFULL;
+	digits = (digits * 10000 + (digits >> 32)) & 0xFFFFFFFFULL;
+	return digits;
+}
+
+// Treat every control character as a separator, that is a single comparison
+int isSpace(char c) {
+	return (unsigned char)c <= ' ';
+}
+
+// One bit for every byte of 8 bytes of text that is a separator, the first byte in the lowest bit
+unsigned int getSpaceMask(unsigned long long bytes) {
+	// Subtracting 0x21 from every byte with its high bit set never borrows from the next byte,
+	// and leaves the high bit set exactly for the bytes that are at least '!' without it
+	unsigned long long notBelow = (bytes | 0x8080808080808080ULL) - 0x2121212121212121ULL;
+	unsigned long long spaces = ~(notBelow | bytes) & 0x8080808080808080ULL;
+
+	// Gather the 8 high bits into one byte with a multiplication
+	return (spaces >> 7) * 0x0102040810204080ULL >> 56;
+}
+
+// Parse every number between start and end into the block, calculating and writing it whenever it's full.
+// Returns 0 if there is something that isn't a valid int.
+int parseNumbers(const char *start, const char *end, BatchState *state) {
+	static const long long powersOfTen[] = {1, 10, 100, 1000};
+	Block *block = state->block;
+
+	// Kept in local variables, so writing the text of a number doesn't make the compiler read them again
+	size_t count = block->count;
+	int hasPendingA = state->hasPendingA;
+	long pairs = state->pairs;
+
+	// A chunk always starts right after a separator
+	unsigned long long isAfterSpace = 1;
+
+	for (const char *window = start; window < end; window += PARSE_WINDOW_SZ) {
+		// First find where all numbers in the window start, a byte that isn't a separator after one that is.
+		// Knowing that up front, no number has to wait for the one before it to be parsed to know where it starts.
+		unsigned long long spaces = 0;
+		for (int i = 0; i < PARSE_WINDOW_SZ / 8; i++) {
+			spaces |= (unsigned long long)getSpaceMask(loadEightBytes(window + i * 8)) << i * 8;
+		}
+		unsigned long long starts = ~spaces & (spaces << 1 | isAfterSpace);
+		isAfterSpace = spaces >> 63;
+
+		// The last window goes past the end of the chunk, anything there isn't part of it
+		if (end - window < PARSE_WINDOW_SZ) {
+			starts &= (1ULL << (end - window)) - 1;
+		}
+
+		for (; starts != 0; starts &= starts - 1) {
+			const char *numberStart = window + __builtin_ctzll(starts);
+			const char *cursor = numberStart;
+
+			// Half of the numbers are negative, so skip the sign without an if the CPU would guess wrong half the time
+			int isNegative = *cursor == '-';
+			cursor += isNegative | (*cursor == '+');
+
+			// Leading zeros don't change the value, scanf takes any amount of them. They're rare, so this if is cheap.
+			const char *digitsStart = cursor;
+			if (*cursor == '0') {
+				cursor += countLeadingZeros(cursor, end);
+			}
+
+			// Look at 8 bytes at once, the slack after the chunk makes that safe even at its end
+			int digits = countLeadingDigits(loadEightBytes(cursor));
+			if (digits > end - cursor) {
+				digits = end - cursor;
+			}
+			long long value = parseEightDigits(loadEightBytes(cursor), digits);
+			cursor += digits;
+
+			// Only a number that filled all 8 bytes can have more digits. More than 10 without the zeros never fit an int,
+			// so take at most 3 more and let the range check below reject it.
+			if (digits == 8) {
+				int moreDigits = countLeadingDigits(loadEightBytes(cursor));
+				if (moreDigits > 3) {
+					moreDigits = 3;
+				}
+				if (moreDigits > end - cursor) {
+					moreDigits = end - cursor;
+				}
+				value = value * powersOfTen[moreDigits] + parseEightDigits(loadEightBytes(cursor), moreDigits);
+				cursor += moreDigits;
+			}
+
+			// The number has to end at a separator, anything else like 12x or 1-2 isn't a number
+			value = isNegative ? -value : value;
+			if (cursor == digitsStart || (cursor < end && !isSpace(*cursor)) || value < INT32_MIN || value > INT32_MAX) {
+				block->count = count;
+				state->hasPendingA = hasPendingA;
+				state->pairs = pairs;
+				return 0;
+			}
+
+			// Numbers come in pairs, the first one waits for the second one
+			int *number = hasPendingA ? &block->b[count] : &block->a[count];
+			char *text = hasPendingA ? block->operands[count] + block->aLength[count] + 1 : block->operands[count];
+			*number = value;
+
+			// Most numbers are already written the way printf writes them, those are copied as they are.
+			// The conditions are combined with & and | instead of && and ||, which would each be an if.
+			size_t length;
+			int isPrintfForm = (*numberStart != '+') & ((*digitsStart != '0') | (cursor - digitsStart == 1)) & !(isNegative & (value == 0));
+			if (isPrintfForm) {
+				memcpy(text, numberStart, OPERAND_TEXT_SZ);
+				length = cursor - numberStart;
+			} else {
+				// Formatting can write past the end of the number, more than a piece has room for
+				char formatted[OPERAND_TEXT_SZ + 8];
+				length = formatNumber(formatted, value);
+				memcpy(text, formatted, OPERAND_TEXT_SZ);
+			}
+
+			if (!hasPendingA) {
+				block->aLength[count] = length;
+				hasPendingA = 1;
+				continue;
+			}
+
+			text[length] = '=';
+			block->operandsLength[count] = block->aLength[count] + length + 2;
+
+			count++;
+			hasPendingA = 0;
+			pairs++;
+
+			if (count == BLOCK_SZ) {
+				block->count = count;
+				calculateBlock(block);
+				formatBlock(&state->buffer, block);
+				count = 0;
+			}
+		}
+	}
+
+	block->count = count;
+	state->hasPendingA = hasPendingA;
+	state->pairs = pairs;
+	return 1;
+}
+
+// Called with every piece of input that ends between two numbers, returns 0 if the input isn't valid
+typedef int (*ChunkHandler)(const char *start, const char *end, void *state);
+
+// Read a file in large chunks and hand every chunk to the handler, returns 0 if the input isn't valid
+int readInChunks(int fd, ChunkHandler handleChunk, void *state) {
+	// Zeroed, so the slack after the end is never read uninitialized
+	char *chunk = calloc(READ_CHUNK_SZ + READ_CHUNK_SLACK, 1);
+	if (chunk == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	size_t carried = 0;
+	int isValid = 1;
+
+	for (;;) {
+		ssize_t bytesRead = read(fd, chunk + carried, READ_CHUNK_SZ - carried);
+		if (bytesRead < 0) {
+			perror("read");
+			exit(EXIT_FAILURE);
+		}
+
+		size_t available = carried + bytesRead;
+
+		// At the end of the input everything is parsed, otherwise keep the last number that might be cut off
+		size_t complete = available;
+		if (bytesRead > 0) {
+			while (complete > 0 && !isSpace(chunk[complete - 1])) {
+				complete--;
+			}
+			if (complete == 0 && available == READ_CHUNK_SZ) {
+				isValid = 0;
+				break;
+			}
+		}
+
+		if (!handleChunk(chunk, chunk + complete, state)) {
+			isValid = 0;
+			break;
+		}
+
+		if (bytesRead == 0) break;
+
+		carried = available - complete;
+		memmove(chunk, chunk + complete, carried);
+	}
+
+	free(chunk);
+	return isValid;
+}
+
+int handlePairChunk(const char *start, const char *end, void *state) {
+	return parseNumbers(start, end, state);
 }
 
-int main() {
+// Read pairs of numbers from one file and write all four results for each pair to another.
+// Returns the amount of pairs, or -1 if the input isn't valid.
+long runBatch(int inputFd, int outputFd) {
+	BatchState state;
+	state.block = malloc(sizeof(Block));
+	state.buffer.data = malloc(OUTPUT_FLUSH_SZ);
+	if (state.block == NULL || state.buffer.data == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	state.block->count = 0;
+	state.buffer.length = 0;
+	state.buffer.fd = outputFd;
+	state.hasPendingA = 0;
+	state.pairs = 0;
+
+	int isValid = readInChunks(inputFd, handlePairChunk, &state);
+
+	// Calculate the last block that isn't full
+	if (isValid && state.block->count > 0) {
+		calculateBlock(state.block);
+		formatBlock(&state.buffer, state.block);
+	}
+	flushOutputBuffer(&state.buffer);
+
+	if (isValid && state.hasPendingA) {
+		fprintf(stderr, "The last number has no partner.\n");
+		isValid = 0;
+	}
+
+	free(state.buffer.data);
+	free(state.block);
+	return isValid ? state.pairs : -1;
+}
+
+// The original way of reading one pair at a time with scanf and printing each result with printf
+long runScanfLoop(FILE *input) {
+	long pairs = 0;
 	int a, b;
-    
+	while (fscanf(input, "%d %d", &a, &b) == 2) {
+		printSum(a, b);
+		printDifference(a, b);
+		printProduct(a, b);
+		printQuotient(a, b);
+		pairs++;
+	}
+	fflush(stdout);
+	return pairs;
+}
+
+// Compare the batch mode with the scanf/printf loop on random pairs
+void runBenchmark(long pairCount) {
+	FILE *input = tmpfile();
+	if (input == NULL) {
+		perror("tmpfile");
+		exit(EXIT_FAILURE);
+	}
+
+	// Always the same pairs, with some large and some zero divisors
+	srand(1);
+	for (long i = 0; i < pairCount; i++) {
+		fprintf(input, "%d %d\n", rand() - RAND_MAX / 2, rand() % 2001 - 1000);
+	}
+	fflush(input);
+
+	// Send the results of both modes to /dev/null, only the time matters
+	if (freopen("/dev/null", "w", stdout) == NULL) {
+		perror("/dev/null");
+		exit(EXIT_FAILURE);
+	}
+
+	rewind(input);
+	double startTime = getMonotonicSeconds();
+	long scanfPairs = runScanfLoop(input);
+	double scanfTime = getMonotonicSeconds() - startTime;
+
+	lseek(fileno(input), 0, SEEK_SET);
+	startTime = getMonotonicSeconds();
+	long batchPairs = runBatch(fileno(input), STDOUT_FILENO);
+	double batchTime = getMonotonicSeconds() - startTime;
+
+	fprintf(stderr, "scanf/printf: %ld pairs in %.3f seconds (%.0f pairs/second)\n", scanfPairs, scanfTime, scanfPairs / scanfTime);
+	fprintf(stderr, "batch:        %ld pairs in %.3f seconds (%.0f pairs/second)\n", batchPairs, batchTime, batchPairs / batchTime);
+	fprintf(stderr, "Speedup: %.1fx\n", scanfTime / batchTime);
+#ifndef __OPTIMIZE__
+	// The scanf loop runs compiled library code either way, so only the batch mode gets slower without -O2
+	fprintf(stderr, "Built without optimizations, compile with -O2 like bench/run.sh for a fair comparison\n");
+#endif
+
+	fclose(input);
+}
+
+// Maximum amount of nodes and instructions in one expression
+#define MAX_EXPRESSION_NODES 256
+
+// Maximum amount of parentheses and signs inside each other, the parser goes one call deeper for each
+#define MAX_EXPRESSION_DEPTH 256
+
+// Maximum amount of variables in one expression, each one is a column of the input
+#define MAX_VARIABLES 16
+#define MAX_VARIABLE_NAME_SZ 32
+
+// Amount of rows that every instruction is run over at once
+#define ROW_BLOCK_SZ 1024
+
+enum NodeType {
+	NodeConstant,
+	NodeVariable,
+	NodeNegate,
+	NodeAdd,
+	NodeSubtract,
+	NodeMultiply,
+	NodeDivide,
+};
+
+typedef struct {
+	int type;
+	double value;
+	int variable;
+	int left;
+	int right;
+} Node;
+
+// The operation is the type of the node it was compiled from, the operand picks a constant or variable
+typedef struct {
+	unsigned char operation;
+	int operand;
+} Instruction;
+
+// An expression compiled into instructions for a stack machine
+typedef struct {
+	Instruction instructions[MAX_EXPRESSION_NODES];
+	int instructionCount;
+	double constants[MAX_EXPRESSION_NODES];
+	int constantCount;
+	int maxStackDepth;
+	char variables[MAX_VARIABLES][MAX_VARIABLE_NAME_SZ];
+	int variableCount;
+} Program;
+
+typedef struct {
+	const char *source;
+	const char *cursor;
+	Node nodes[MAX_EXPRESSION_NODES];
+	int nodeCount;
+	int depth;
+	Program *program;
+} Parser;
+
+// Everything the expression mode keeps between chunks of input
+typedef struct {
+	const Program *program;
+	double *columns[MAX_VARIABLES];
+	double *stack;
+	double results[ROW_BLOCK_SZ];
+	size_t rowCount;
+	// Amount of numbers so far on the current line, and which line of the input that is
+	int column;
+	long line;
+	long rows;
+	OutputBuffer buffer;
+} ExpressionState;
+
+void failParsing(Parser *parser, const char *message) {
+	fprintf(stderr, "%s at position %d: %s\n", message, (int)(parser->cursor - parser->source), parser->source);
+	exit(EXIT_FAILURE);
+}
+
+int addNode(Parser *parser, int type, int left, int right) {
+	if (parser->nodeCount == MAX_EXPRESSION_NODES) {
+		failParsing(parser, "Expression is too long");
+	}
+
+	Node *node = &parser->nodes[parser->nodeCount];
+	node->type = type;
+	node->value = 0;
+	node->variable = -1;
+	node->left = left;
+	node->right = right;
+	return parser->nodeCount++;
+}
+
+// Turn a node whose children are both constants into a single constant
+int foldConstants(Parser *parser, int index) {
+	Node *node = &parser->nodes[index];
+	Node *left = &parser->nodes[node->left];
+
+	if (left->type != NodeConstant) return index;
+
+	if (node->type == NodeNegate) {
+		node->value = -left->value;
+	} else {
+		Node *right = &parser->nodes[node->right];
+		if (right->type != NodeConstant) return index;
+
+		switch (node->type) {
+			case NodeAdd:
+				node->value = left->value + right->value;
+				break;
+			case NodeSubtract:
+				node->value = left->value - right->value;
+				break;
+			case NodeMultiply:
+				node->value = left->value * right->value;
+				break;
+			default:
+				node->value = left->value / right->value;
+				break;
+		}
+	}
+	node->type = NodeConstant;
+	return index;
+}
+
+void skipSpaces(Parser *parser) {
+	while (*parser->cursor == ' ' || *parser->cursor == '\t') {
+		parser->cursor++;
+	}
+}
+
+int isLetter(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+int isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+int parseSum(Parser *parser);
+
+// primary := number | variable | '(' sum ')'
+int parsePrimary(Parser *parser) {
+	skipSpaces(parser);
+	const char *start = parser->cursor;
+
+	if (*start == '(') {
+		parser->cursor++;
+		int inner = parseSum(parser);
+		skipSpaces(parser);
+		if (*parser->cursor != ')') {
+			failParsing(parser, "Expected )");
+		}
+		parser->cursor++;
+		return inner;
+	}
+
+	if (isDigit(*start) || *start == '.') {
+		char *end;
+		double value = strtod(start, &end);
+		if (end == start) {
+			failParsing(parser, "Invalid number");
+		}
+		parser->cursor = end;
+
+		int index = addNode(parser, NodeConstant, -1, -1);
+		parser->nodes[index].value = value;
+		return index;
+	}
+
+	if (isLetter(*start)) {
+		while (isLetter(*parser->cursor) || isDigit(*parser->cursor)) {
+			parser->cursor++;
+		}
+		int length = parser->cursor - start;
+		if (length >= MAX_VARIABLE_NAME_SZ) {
+			failParsing(parser, "Variable name is too long");
+		}
+
+		// Every variable gets a column the first time it shows up
+		Program *program = parser->program;
+		int variable = 0;
+		while (variable < program->variableCount &&
+			!(strncmp(program->variables[variable], start, length) == 0 && program->variables[variable][length] == '\0')) {
+			variable++;
+		}
+		if (variable == program->variableCount) {
+			if (variable == MAX_VARIABLES) {
+				failParsing(parser, "Too many variables");
+			}
+			memcpy(program->variables[variable], start, length);
+			program->variables[variable][length] = '\0';
+			program->variableCount++;
+		}
+
+		int index = addNode(parser, NodeVariable, -1, -1);
+		parser->nodes[index].variable = variable;
+		return index;
+	}
+
+	failParsing(parser, "Expected a number, variable or (");
+	return -1;
+}
+
+// unary := '-' unary | '+' unary | primary
+int parseUnary(Parser *parser) {
+	// Every nested sign or parenthesis comes through here, so this is where the recursion is limited
+	if (++parser->depth > MAX_EXPRESSION_DEPTH) {
+		failParsing(parser, "Expression is nested too deeply");
+	}
+
+	int index;
+	skipSpaces(parser);
+	if (*parser->cursor == '-') {
+		parser->cursor++;
+		int operand = parseUnary(parser);
+		index = foldConstants(parser, addNode(parser, NodeNegate, operand, -1));
+	} else if (*parser->cursor == '+') {
+		parser->cursor++;
+		index = parseUnary(parser);
+	} else {
+		index = parsePrimary(parser);
+	}
+
+	parser->depth--;
+	return index;
+}
+
+// product := unary (('*' | '/') unary)*
+int parseProduct(Parser *parser) {
+	int left = parseUnary(parser);
+	for (;;) {
+		skipSpaces(parser);
+		char operator = *parser->cursor;
+		if (operator != '*' && operator != '/') return left;
+
+		parser->cursor++;
+		int right = parseUnary(parser);
+		left = foldConstants(parser, addNode(parser, operator == '*' ? NodeMultiply : NodeDivide, left, right));
+	}
+}
+
+// sum := product (('+' | '-') product)*
+int parseSum(Parser *parser) {
+	int left = parseProduct(parser);
+	for (;;) {
+		skipSpaces(parser);
+		char operator = *parser->cursor;
+		if (operator != '+' && operator != '-') return left;
+
+		parser->cursor++;
+		int right = parseProduct(parser);
+		left = foldConstants(parser, addNode(parser, operator == '+' ? NodeAdd : NodeSubtract, left, right));
+	}
+}
+
+// Emit the instructions for a node after those of its children, returns the stack depth it needs
+int emitNode(Program *program, const Node nodes[], int index, int depth) {
+	const Node *node = &nodes[index];
+	Instruction *instruction = &program->instructions[program->instructionCount++];
+	int maxDepth = depth + 1;
+
+	if (node->type == NodeConstant) {
+		program->constants[program->constantCount] = node->value;
+		instruction->operation = NodeConstant;
+		instruction->operand = program->constantCount++;
+		return maxDepth;
+	}
+	if (node->type == NodeVariable) {
+		instruction->operation = NodeVariable;
+		instruction->operand = node->variable;
+		return maxDepth;
+	}
+
+	// The children go first, so take back the slot and fill it in afterwards
+	program->instructionCount--;
+	maxDepth = emitNode(program, nodes, node->left, depth);
+	if (node->type != NodeNegate) {
+		int rightDepth = emitNode(program, nodes, node->right, depth + 1);
+		maxDepth = rightDepth > maxDepth ? rightDepth : maxDepth;
+	}
+
+	instruction = &program->instructions[program->instructionCount++];
+	instruction->operation = node->type;
+	instruction->operand = 0;
+	return maxDepth;
+}
+
+// Parse the expression once and compile it into a program that can run over many rows
+Program compileExpression(const char *source) {
+	static Parser parser;
+	Program program;
+	program.instructionCount = 0;
+	program.constantCount = 0;
+	program.variableCount = 0;
+
+	parser.source = source;
+	parser.cursor = source;
+	parser.nodeCount = 0;
+	parser.depth = 0;
+	parser.program = &program;
+
+	int root = parseSum(&parser);
+	skipSpaces(&parser);
+	if (*parser.cursor != '\0') {
+		failParsing(&parser, "Unexpected character");
+	}
+
+	program.maxStackDepth = emitNode(&program, parser.nodes, root, 0);
+	return program;
+}
+
+// Run the program over a block of rows, one instruction at a time for all rows.
+// The stack holds maxStackDepth rows of ROW_BLOCK_SZ values each.
+void evaluateBlock(const Program *program, double *const columns[], size_t count, double *stack, double *results) {
+	int top = -1;
+
+	for (int i = 0; i < program->instructionCount; i++) {
+		const Instruction *instruction = &program->instructions[i];
+		double *restrict target;
+		const double *restrict operand;
+
+		if (instruction->operation == NodeConstant) {
+			double value = program->constants[instruction->operand];
+			top++;
+			target = stack + top * ROW_BLOCK_SZ;
+			for (size_t row = 0; row < count; row++) target[row] = value;
+			continue;
+		}
+		if (instruction->operation == NodeVariable) {
+			top++;
+			memcpy(stack + top * ROW_BLOCK_SZ, columns[instruction->operand], count * sizeof(double));
+			continue;
+		}
+		if (instruction->operation == NodeNegate) {
+			target = stack + top * ROW_BLOCK_SZ;
+			for (size_t row = 0; row < count; row++) target[row] = -target[row];
+			continue;
+		}
+
+		// Binary operations combine the two values on top into one
+		target = stack + (top - 1) * ROW_BLOCK_SZ;
+		operand = stack + top * ROW_BLOCK_SZ;
+		top--;
+
+		switch (instruction->operation) {
+			case NodeAdd:
+				for (size_t row = 0; row < count; row++) target[row] += operand[row];
+				break;
+			case NodeSubtract:
+				for (size_t row = 0; row < count; row++) target[row] -= operand[row];
+				break;
+			case NodeMultiply:
+				for (size_t row = 0; row < count; row++) target[row] *= operand[row];
+				break;
+			case NodeDivide:
+				for (size_t row = 0; row < count; row++) target[row] /= operand[row];
+				break;
+		}
+	}
+
+	memcpy(results, stack, count * sizeof(double));
+}
+
+// Write a result with two decimals like printQuotient, or undefined if it was divided by zero
+char *formatDecimal(char *out, double value) {
+	if (isnan(value) || isinf(value)) {
+		memcpy(out, "undefined", 9);
+		return out + 9;
+	}
+
+	// Too large for the integer path, let snprintf deal with it.
+	// Below this the hundredths and the halves between them are all exact as a double.
+	if (value > 1e13 || value < -1e13) {
+		int length = snprintf(out, MAX_DECIMAL_OUTPUT, "%.2f", value);
+		// snprintf returns what it wanted to write, which can be more than what fit
+		return out + (length < MAX_DECIMAL_OUTPUT ? length : MAX_DECIMAL_OUTPUT - 1);
+	}
+
+	double magnitude = value < 0 ? -value : value;
+	// Round an exact half to even, like the quotient of two ints and snprintf above
+	long long hundredths = (long long)nearbyint(magnitude * 100);
+
+	// Multiplying by 100 rounds too, which can move a value onto or over a half. Close to one,
+	// fma finds out exactly which side of it the value is on, rounding only the final difference.
+	double distance = fabs(magnitude * 100 - hundredths);
+	if (distance > 0.499 && distance < 0.501) {
+		double aboveHalf = fma(magnitude, 100, -(hundredths + 0.5));
+		double belowHalf = fma(magnitude, 100, -(hundredths - 0.5));
+		int isOdd = hundredths % 2;
+		hundredths += (aboveHalf > 0 || (aboveHalf == 0 && isOdd)) - (belowHalf < 0 || (belowHalf == 0 && isOdd));
+	}
+	if (value < 0) {
+		*out++ = '-';
+	}
+	out += formatNumber(out, hundredths / 100);
+	*out++ = '.';
+	*out++ = '0' + hundredths % 100 / 10;
+	*out++ = '0' + hundredths % 10;
+	return out;
+}
+
+void flushExpressionBlock(ExpressionState *state) {
+	evaluateBlock(state->program, state->columns, state->rowCount, state->stack, state->results);
+
+	for (size_t row = 0; row < state->rowCount; row++) {
+		// One extra byte for the new line
+		if (state->buffer.length + MAX_DECIMAL_OUTPUT + 1 > OUTPUT_FLUSH_SZ) {
+			flushOutputBuffer(&state->buffer);
+		}
+		char *out = formatDecimal(state->buffer.data + state->buffer.length, state->results[row]);
+		*out++ = '\n';
+		state->buffer.length = out - state->buffer.data;
+	}
+
+	state->rows += state->rowCount;
+	state->rowCount = 0;
+}
+
+// Parse a number the slow way with strtod, for exponents like 1e-05 and numbers with many digits.
+// Returns 0 if the whole text up to the next separator isn't a number.
+int parseLongDecimal(const char **cursor, const char *end, double *value) {
+	// strtod needs the text to end with a 0, which the chunk doesn't have
+	char text[MAX_NUMBER_TEXT_SZ];
+	size_t length = 0;
+	while (*cursor + length < end && !isSpace((*cursor)[length])) {
+		// Only what a number in the expression can have, strtod would also take things like inf or 0x10
+		char c = (*cursor)[length];
+		if (length == sizeof(text) - 1 || !(isDigit(c) || c == '.' || c == 'e' || c == 'E' || c == '-' || c == '+')) return 0;
+		text[length++] = c;
+	}
+	text[length] = '\0';
+
+	char *textEnd;
+	*value = strtod(text, &textEnd);
+	if (length == 0 || textEnd != text + length) return 0;
+
+	*cursor += length;
+	return 1;
+}
+
+// Parse a decimal number like 12, -3.5 or .25, returns 0 if it isn't one
+int parseDecimal(const char **cursor, const char *end, double *value) {
+	static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15};
+	const char *position = *cursor;
+
+	int isNegative = *position == '-';
+	if (*position == '-' || *position == '+') {
+		position++;
+	}
+
+	// All digits go into one integer, the decimal point only decides what it is divided by
+	unsigned long long mantissa = 0;
+	int digits = 0, decimals = 0, isFraction = 0;
+	for (; position < end; position++) {
+		if (*position == '.' && !isFraction) {
+			isFraction = 1;
+		} else if (isDigit(*position) && digits < 15) {
+			mantissa = mantissa * 10 + (*position - '0');
+			digits++;
+			decimals += isFraction;
+		} else {
+			break;
+		}
+	}
+
+	// Up to 15 digits fit a double exactly, so dividing by the exact power of ten rounds only once.
+	// Anything else, like an exponent or more digits, is left to strtod.
+	if (digits == 0 || (position < end && !isSpace(*position))) {
+		return parseLongDecimal(cursor, end, value);
+	}
+
+	*value = (isNegative ? -(double)mantissa : (double)mantissa) / powersOfTen[decimals];
+	*cursor = position;
+	return 1;
+}
+
+void reportRowLength(const ExpressionState *state) {
+	fprintf(stderr, "Row %ld has %s numbers, expected %d.\n", state->line,
+		state->column < state->program->variableCount ? "too few" : "too many", state->program->variableCount);
+}
+
+// Every line is one row, empty lines are skipped
+int handleExpressionChunk(const char *start, const char *end, void *argument) {
+	ExpressionState *state = argument;
+	int variableCount = state->program->variableCount;
+	const char *cursor = start;
+
+	for (;;) {
+		while (cursor < end && isSpace(*cursor)) {
+			if (*cursor == '\n') {
+				// A full row was already added with its last number, so only a partial one is left to check
+				if (state->column != 0 && state->column != variableCount) {
+					reportRowLength(state);
+					return 0;
+				}
+				state->column = 0;
+				state->line++;
+			}
+			cursor++;
+		}
+		if (cursor == end) return 1;
+
+		if (state->column == variableCount) {
+			state->column++;
+			reportRowLength(state);
+			return 0;
+		}
+
+		double value;
+		if (!parseDecimal(&cursor, end, &value)) {
+			fprintf(stderr, "Row %ld has something that isn't a number.\n", state->line);
+			return 0;
+		}
+
+		// The numbers fill the variables of a row in the order they appear in the expression
+		state->columns[state->column][state->rowCount] = value;
+		if (++state->column < variableCount) continue;
+
+		if (++state->rowCount == ROW_BLOCK_SZ) {
+			flushExpressionBlock(state);
+		}
+	}
+}
+
+ExpressionState createExpressionState(const Program *program, int outputFd) {
+	ExpressionState state;
+	state.program = program;
+	state.stack = malloc(program->maxStackDepth * ROW_BLOCK_SZ * sizeof(double));
+	state.buffer.data = malloc(OUTPUT_FLUSH_SZ);
+	state.buffer.length = 0;
+	state.buffer.fd = outputFd;
+	state.rowCount = 0;
+	state.column = 0;
+	state.line = 1;
+	state.rows = 0;
+
+	for (int i = 0; i < program->variableCount; i++) {
+		state.columns[i] = malloc(ROW_BLOCK_SZ * sizeof(double));
+		if (state.columns[i] == NULL) {
+			fprintf(stderr, "Memory allocation failed.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (state.stack == NULL || state.buffer.data == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+	return state;
+}
+
+void freeExpressionState(ExpressionState *state) {
+	for (int i = 0; i < state->program->variableCount; i++) {
+		free(state->columns[i]);
+	}
+	free(state->stack);
+	free(state->buffer.data);
+}
+
+// Evaluate the expression for every row of numbers on stdin, one result per line
+int runExpression(const char *source) {
+	Program program = compileExpression(source);
+	ExpressionState state = createExpressionState(&program, STDOUT_FILENO);
+	int isValid = 1;
+
+	if (program.variableCount == 0) {
+		// Without variables there is exactly one result
+		state.rowCount = 1;
+		flushExpressionBlock(&state);
+	} else {
+		isValid = readInChunks(STDIN_FILENO, handleExpressionChunk, &state);
+		// Without a new line at the end the last row is only checked here
+		if (isValid && state.column != 0 && state.column != program.variableCount) {
+			fprintf(stderr, "The last row is incomplete.\n");
+			isValid = 0;
+		}
+		if (isValid && state.rowCount > 0) {
+			flushExpressionBlock(&state);
+		}
+	}
+	flushOutputBuffer(&state.buffer);
+
+	if (!isValid) {
+		fprintf(stderr, "Invalid input, expected rows of %d numbers for", program.variableCount);
+		for (int i = 0; i < program.variableCount; i++) {
+			fprintf(stderr, " %s", program.variables[i]);
+		}
+		fprintf(stderr, ".\n");
+	}
+
+	freeExpressionState(&state);
+	return isValid;
+}
+
+// Measure how long the evaluation takes per row, without reading or writing anything
+void runExpressionBenchmark(const char *source, long rows) {
+	Program program = compileExpression(source);
+	ExpressionState state = createExpressionState(&program, -1);
+
+	// Random values that are never zero, so the divisions stay defined
+	srand(1);
+	for (int i = 0; i < program.variableCount; i++) {
+		for (size_t row = 0; row < ROW_BLOCK_SZ; row++) {
+			state.columns[i][row] = rand() % 2000 - 999.5;
+		}
+	}
+
+	double checksum = 0;
+	double startTime = getMonotonicSeconds();
+	for (long done = 0; done < rows; done += ROW_BLOCK_SZ) {
+		size_t count = rows - done < ROW_BLOCK_SZ ? rows - done : ROW_BLOCK_SZ;
+		evaluateBlock(&program, state.columns, count, state.stack, state.results);
+		checksum += state.results[0];
+	}
+	double elapsed = getMonotonicSeconds() - startTime;
+
+	fprintf(stderr, "%d instructions, %d variables, stack depth %d\n", program.instructionCount, program.variableCount, program.maxStackDepth);
+	fprintf(stderr, "Evaluated %ld rows in %.3f seconds (%.2f ns/row, checksum %g)\n", rows, elapsed, elapsed * 1e9 / rows, checksum);
+
+	freeExpressionState(&state);
+}
+
+int main(int argc, char *argv[]) {
+	initDigitTable();
+
+	if (argc == 2 && strcmp(argv[1], "--batch") == 0) {
+		// Read pairs from stdin until it ends
+		if (runBatch(STDIN_FILENO, STDOUT_FILENO) < 0) {
+			fprintf(stderr, "Invalid input, expected pairs of integers.\n");
+			return 1;
+		}
+		return 0;
+	}
+
+	if (argc == 3 && strcmp(argv[1], "--bench") == 0) {
+		runBenchmark(atol(argv[2]));
+		return 0;
+	}
+
+	if (argc == 3 && strcmp(argv[1], "--expr") == 0) {
+		// Read rows of variables from stdin and print the result for each
+		return runExpression(argv[2]) ? 0 : 1;
+	}
+
+	if (argc == 4 && strcmp(argv[1], "--expr-bench") == 0) {
+		runExpressionBenchmark(argv[2], atol(argv[3]));
+		return 0;
+	}
+
+	if (argc != 1) {
+		fprintf(stderr, "Usage: %s [--batch | --bench PAIRS | --expr EXPRESSION | --expr-bench EXPRESSION ROWS]\n", argv[0]);
+		return 1;
+	}
+
+	int a, b;
+
 	printf("Enter two numbers: ");
-	scanf("%d %d", &a, &b);
+	if (scanf("%d %d", &a, &b) != 2) {
+		printf("Those are not two numbers.\n");
+		return 1;
+	}
 
 	printSum(a, b);
 	printDifference(a, b);
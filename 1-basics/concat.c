@@ -1,10 +1,276 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+// Size of the chunks stdin is read in, it grows if a single name doesn't fit
+#define READ_CHUNK_SZ (1 << 20)
+
+// Amount of pieces handed to the kernel in one writev call
+#define IOV_BATCH_SZ 1024
+
+const char firstPrefix[] = "Hello, ";
+const char separator[] = "!\nHello, ";
+const char lastSuffix[] = "!\n";
+
+// Collects pieces of output that point into the input, so names are never copied
+typedef struct {
+	struct iovec vectors[IOV_BATCH_SZ];
+	int count;
+	int fd;
+	long lines;
+} GreetingWriter;
+
+double getMonotonicSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Write all pieces, writev may stop anywhere in between
+void flushGreetings(GreetingWriter *writer) {
+	struct iovec *vectors = writer->vectors;
+	int count = writer->count;
+
+	while (count > 0) {
+		ssize_t written = writev(writer->fd, vectors, count);
+		if (written < 0) {
+			perror("writev");
+			exit(EXIT_FAILURE);
+		}
+
+		// Skip the pieces that are completely written and shorten the one that is half written
+		while (count > 0 && (size_t)written >= vectors->iov_len) {
+			written -= vectors->iov_len;
+			vectors++;
+			count--;
+		}
+		if (count > 0) {
+			vectors->iov_base = (char *)vectors->iov_base + written;
+			vectors->iov_len -= written;
+		}
+	}
+	writer->count = 0;
+}
+
+void addPiece(GreetingWriter *writer, const char *data, size_t length) {
+	if (writer->count == IOV_BATCH_SZ) {
+		flushGreetings(writer);
+	}
+	writer->vectors[writer->count].iov_base = (void *)data;
+	writer->vectors[writer->count].iov_len = length;
+	writer->count++;
+}
+
+// "!\n" of one greeting and "Hello, " of the next are one piece, so every name only needs two
+void addGreeting(GreetingWriter *writer, const char *name, size_t length) {
+	if (writer->lines == 0) {
+		addPiece(writer, firstPrefix, sizeof(firstPrefix) - 1);
+	} else {
+		addPiece(writer, separator, sizeof(separator) - 1);
+	}
+	if (length > 0) {
+		addPiece(writer, name, length);
+	}
+	writer->lines++;
+}
+
+void finishGreetings(GreetingWriter *writer) {
+	if (writer->lines > 0) {
+		addPiece(writer, lastSuffix, sizeof(lastSuffix) - 1);
+	}
+	flushGreetings(writer);
+}
+
+// Greet every complete line between start and end, returns where the unfinished last line starts
+const char *greetLines(GreetingWriter *writer, const char *start, const char *end) {
+	const char *lineStart = start;
+	for (;;) {
+		const char *newLine = memchr(lineStart, '\n', end - lineStart);
+		if (newLine == NULL) return lineStart;
+
+		// Leave out the carriage return of windows line endings
+		const char *nameEnd = newLine > lineStart && newLine[-1] == '\r' ? newLine - 1 : newLine;
+		addGreeting(writer, lineStart, nameEnd - lineStart);
+		lineStart = newLine + 1;
+	}
+}
+
+void greetLastLine(GreetingWriter *writer, const char *start, const char *end) {
+	if (end > start && end[-1] == '\r') end--;
+	if (end > start) {
+		addGreeting(writer, start, end - start);
+	}
+}
+
+// Map the whole file and greet straight out of the mapping
+long greetMappedFile(const char *path, int outputFd) {
+	GreetingWriter writer;
+	writer.count = 0;
+	writer.fd = outputFd;
+	writer.lines = 0;
+
+	int fd = open(path, O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) < 0) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	if (info.st_size > 0) {
+		char *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			perror(path);
+			exit(EXIT_FAILURE);
+		}
+		madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+		const char *rest = greetLines(&writer, data, data + info.st_size);
+		greetLastLine(&writer, rest, data + info.st_size);
+		finishGreetings(&writer);
+
+		munmap(data, info.st_size);
+	}
+
+	close(fd);
+	return writer.lines;
+}
+
+// Read a file in large chunks and greet out of the chunk, the pieces are written before the chunk is reused
+long greetStream(int inputFd, int outputFd) {
+	GreetingWriter writer;
+	writer.count = 0;
+	writer.fd = outputFd;
+	writer.lines = 0;
+
+	size_t capacity = READ_CHUNK_SZ;
+	char *chunk = malloc(capacity);
+	if (chunk == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+	size_t carried = 0;
+
+	for (;;) {
+		ssize_t bytesRead = read(inputFd, chunk + carried, capacity - carried);
+		if (bytesRead < 0) {
+			perror("read");
+			exit(EXIT_FAILURE);
+		}
+		if (bytesRead == 0) break;
+
+		size_t available = carried + bytesRead;
+		const char *rest = greetLines(&writer, chunk, chunk + available);
+		flushGreetings(&writer);
+
+		// Keep the unfinished name, and make room if it fills the whole chunk
+		carried = chunk + available - rest;
+		memmove(chunk, rest, carried);
+		if (carried == capacity) {
+			capacity *= 2;
+			chunk = realloc(chunk, capacity);
+			if (chunk == NULL) {
+				fprintf(stderr, "Memory allocation failed.\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	greetLastLine(&writer, chunk, chunk + carried);
+	finishGreetings(&writer);
+
+	free(chunk);
+	return writer.lines;
+}
+
+// The original way, one name at a time with scanf and printf
+long greetWithScanf(FILE *input) {
+	char name[32];
+	long lines = 0;
+	while (fscanf(input, "%31s", name) == 1) {
+		printf("Hello, %s!\n", name);
+		lines++;
+	}
+	fflush(stdout);
+	return lines;
+}
+
+// Compare the streaming modes with scanf and printf on generated names
+void runBenchmark(long count) {
+	char path[] = "/tmp/concat-bench-XXXXXX";
+	int fd = mkstemp(path);
+	FILE *input = fd >= 0 ? fdopen(fd, "w+") : NULL;
+	if (input == NULL) {
+		perror("mkstemp");
+		exit(EXIT_FAILURE);
+	}
+
+	for (long i = 0; i < count; i++) {
+		fprintf(input, "Name%ld\n", i);
+	}
+	fflush(input);
+
+	// Only the time matters, so the greetings go to /dev/null
+	if (freopen("/dev/null", "w", stdout) == NULL) {
+		perror("/dev/null");
+		exit(EXIT_FAILURE);
+	}
+
+	rewind(input);
+	double startTime = getMonotonicSeconds();
+	long scanfLines = greetWithScanf(input);
+	double scanfTime = getMonotonicSeconds() - startTime;
+
+	lseek(fd, 0, SEEK_SET);
+	startTime = getMonotonicSeconds();
+	long streamLines = greetStream(fd, STDOUT_FILENO);
+	double streamTime = getMonotonicSeconds() - startTime;
+
+	startTime = getMonotonicSeconds();
+	long mappedLines = greetMappedFile(path, STDOUT_FILENO);
+	double mappedTime = getMonotonicSeconds() - startTime;
+
+	fprintf(stderr, "scanf/printf: %ld lines in %.3f seconds (%.0f lines/second)\n", scanfLines, scanfTime, scanfLines / scanfTime);
+	fprintf(stderr, "stream:       %ld lines in %.3f seconds (%.0f lines/second)\n", streamLines, streamTime, streamLines / streamTime);
+	fprintf(stderr, "mapped:       %ld lines in %.3f seconds (%.0f lines/second)\n", mappedLines, mappedTime, mappedLines / mappedTime);
+
+	fclose(input);
+	unlink(path);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc >= 2 && strcmp(argv[1], "--stream") == 0 && argc <= 3) {
+		// Greet every line of a file, or of stdin if there is no file
+		double startTime = getMonotonicSeconds();
+		long lines = argc == 3 ? greetMappedFile(argv[2], STDOUT_FILENO) : greetStream(STDIN_FILENO, STDOUT_FILENO);
+		double elapsed = getMonotonicSeconds() - startTime;
+
+		fprintf(stderr, "%ld lines in %.3f seconds (%.0f lines/second)\n", lines, elapsed, lines / elapsed);
+		return 0;
+	}
+
+	if (argc == 3 && strcmp(argv[1], "--bench") == 0) {
+		runBenchmark(atol(argv[2]));
+		return 0;
+	}
+
+	if (argc != 1) {
+		fprintf(stderr, "Usage: %s [--stream [FILE] | --bench LINES]\n", argv[0]);
+		return 1;
+	}
 
-int main() {
 	printf("Enter your name: ");
 	char name[32];
-	// %s is used to read a string
-	scanf("%s", &name);
+	// %s is used to read a string, %31s stops before it runs past the end of name
+	if (scanf("%31s", name) != 1) {
+		printf("No name was entered.\n");
+		return 1;
+	}
 
 	printf("Hello, %s!\n", name);
     return 0;
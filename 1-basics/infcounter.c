@@ -1,10 +1,210 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
 
-int main() {
-	int counter = 0;
+#define MAX_THREADS 64
+
+// Counters on different cache lines of this size can't slow each other down
+#define CACHE_LINE_SZ 64
+
+// Every thread counts this many times between looking at the stop flag
+#define INNER_LOOP_SZ 1024
+
+enum CounterMode {
+	SharedAtomic,
+	ShardedUnpadded,
+	ShardedPadded,
+	ThreadLocalBatched,
+	MODE_COUNT,
+};
+
+const char *modeNames[] = {
+	"shared-atomic",
+	"sharded-unpadded",
+	"sharded-padded",
+	"local-batched",
+};
+
+// One counter per thread, padded so every counter has its own cache line
+typedef struct {
+	_Alignas(CACHE_LINE_SZ) _Atomic uint64_t count;
+} PaddedShard;
+
+typedef struct {
+	int mode;
+	int index;
+} Worker;
+
+_Atomic uint64_t sharedCounter;
+_Atomic uint64_t unpaddedShards[MAX_THREADS];
+PaddedShard paddedShards[MAX_THREADS];
+atomic_bool shouldStop;
+pthread_barrier_t startBarrier;
+
+// The shards are only added up when someone wants to read the total
+uint64_t readCounter(int mode, int threadCount) {
+	uint64_t total = 0;
+	switch (mode) {
+		case ShardedUnpadded:
+			for (int i = 0; i < threadCount; i++) {
+				total += atomic_load_explicit(&unpaddedShards[i], memory_order_relaxed);
+			}
+			return total;
+		case ShardedPadded:
+			for (int i = 0; i < threadCount; i++) {
+				total += atomic_load_explicit(&paddedShards[i].count, memory_order_relaxed);
+			}
+			return total;
+		default:
+			return atomic_load(&sharedCounter);
+	}
+}
+
+void *count(void *argument) {
+	Worker *worker = argument;
+	_Atomic uint64_t *unpadded = &unpaddedShards[worker->index];
+	_Atomic uint64_t *padded = &paddedShards[worker->index].count;
+
+	pthread_barrier_wait(&startBarrier);
+
+	while (!atomic_load_explicit(&shouldStop, memory_order_relaxed)) {
+		switch (worker->mode) {
+			case SharedAtomic:
+				// Every increment fights over the same cache line
+				for (int i = 0; i < INNER_LOOP_SZ; i++) {
+					atomic_fetch_add_explicit(&sharedCounter, 1, memory_order_relaxed);
+				}
+				break;
+			case ShardedUnpadded:
+				// Every thread has its own counter, but neighbours still share a cache line
+				for (int i = 0; i < INNER_LOOP_SZ; i++) {
+					atomic_fetch_add_explicit(unpadded, 1, memory_order_relaxed);
+				}
+				break;
+			case ShardedPadded:
+				for (int i = 0; i < INNER_LOOP_SZ; i++) {
+					atomic_fetch_add_explicit(padded, 1, memory_order_relaxed);
+				}
+				break;
+			case ThreadLocalBatched: {
+				// Count in a plain local variable and publish the whole batch at once
+				uint64_t local = 0;
+				for (int i = 0; i < INNER_LOOP_SZ; i++) {
+					// Stop the compiler from turning the loop into a single addition
+					__asm__ volatile("" : "+r"(local));
+					local++;
+				}
+				atomic_fetch_add_explicit(&sharedCounter, local, memory_order_relaxed);
+				break;
+			}
+		}
+	}
+	return NULL;
+}
+
+double getMonotonicSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Let the threads count for the given time, returns the increments per second
+double runCounterBenchmark(int mode, int threadCount, double seconds) {
+	pthread_t threads[MAX_THREADS];
+	Worker workers[MAX_THREADS];
+
+	atomic_store(&sharedCounter, 0);
+	for (int i = 0; i < MAX_THREADS; i++) {
+		atomic_store(&unpaddedShards[i], 0);
+		atomic_store(&paddedShards[i].count, 0);
+	}
+	atomic_store(&shouldStop, false);
+	pthread_barrier_init(&startBarrier, NULL, threadCount + 1);
+
+	for (int i = 0; i < threadCount; i++) {
+		workers[i].mode = mode;
+		workers[i].index = i;
+		pthread_create(&threads[i], NULL, count, &workers[i]);
+	}
+
+	// Start the clock once every thread is ready
+	pthread_barrier_wait(&startBarrier);
+	double startTime = getMonotonicSeconds();
+
+	struct timespec duration;
+	duration.tv_sec = (time_t)seconds;
+	duration.tv_nsec = (seconds - duration.tv_sec) * 1e9;
+	nanosleep(&duration, NULL);
+
+	atomic_store(&shouldStop, true);
+	for (int i = 0; i < threadCount; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	double elapsed = getMonotonicSeconds() - startTime;
+
+	pthread_barrier_destroy(&startBarrier);
+	return readCounter(mode, threadCount) / elapsed;
+}
+
+void runBenchmarks(int maxThreads, double seconds) {
+	printf("%-18s %8s %18s %18s\n", "mode", "threads", "increments/s", "per thread/s");
+
+	for (int mode = 0; mode < MODE_COUNT; mode++) {
+		// Double the threads each time, and always include the maximum
+		for (int threadCount = 1; ; threadCount *= 2) {
+			if (threadCount > maxThreads) {
+				threadCount = maxThreads;
+			}
+
+			double rate = runCounterBenchmark(mode, threadCount, seconds);
+			printf("%-18s %8d %18.0f %18.0f\n", modeNames[mode], threadCount, rate, rate / threadCount);
+			fflush(stdout);
+
+			if (threadCount == maxThreads) break;
+		}
+	}
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1) {
+		int maxThreads = 4;
+		double seconds = 1;
+
+		for (int i = 1; i < argc; i++) {
+			if (strcmp(argv[i], "--bench") == 0) {
+				continue;
+			} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+				maxThreads = atoi(argv[++i]);
+			} else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+				seconds = atof(argv[++i]);
+			} else {
+				fprintf(stderr, "Usage: %s [--bench [--threads MAX] [--seconds S]]\n", argv[0]);
+				return 1;
+			}
+		}
+
+		if (maxThreads < 1 || maxThreads > MAX_THREADS || seconds <= 0) {
+			fprintf(stderr, "Threads must be between 1 and %d and seconds above 0.\n", MAX_THREADS);
+			return 1;
+		}
+
+		runBenchmarks(maxThreads, seconds);
+		return 0;
+	}
+
+	// A 64 bit counter takes centuries to overflow
+	uint64_t counter = 0;
+	uint64_t nextPrint = 0;
 	while (1) {
-		if (counter % 100000000 == 0) {
-			printf("%d\n", counter);
+		// Comparing with the next milestone is cheaper than a modulo every time
+		if (counter == nextPrint) {
+			printf("%llu\n", (unsigned long long)counter);
+			nextPrint += 100000000;
 		}
 		counter++;
 	}
@@ -1,11 +1,528 @@
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
 
-int main() {
-	srand(time(NULL));
-	int randomNumber = rand();
+// Amount of numbers in one block, every block comes from its own stream
+#define BLOCK_SZ (1 << 18)
 
-	printf("Random number: %d\n", randomNumber);
-    return 0;
+// Longest number in text form, a sign, 19 digits and a new line
+#define MAX_NUMBER_TEXT 21
+
+#define MAX_THREADS 64
+
+// Every PCG block starts this many draws after the previous one
+#define PCG_BLOCK_DISTANCE (1ULL << 40)
+
+enum Generator {
+	GeneratorLibc,
+	GeneratorXoshiro,
+	GeneratorPcg,
+	GeneratorXoshiroX4,
+	GENERATOR_COUNT,
+};
+
+const char *generatorNames[] = {"libc", "xoshiro", "pcg", "xoshiro-x4"};
+
+enum Distribution {
+	DistributionUniform,
+	DistributionNormal,
+};
+
+enum Format {
+	FormatText,
+	FormatBinary,
+};
+
+typedef struct {
+	int generator;
+	int distribution;
+	int format;
+	int64_t min;
+	int64_t max;
+	uint64_t seed;
+	long long count;
+	int threadCount;
+} Options;
+
+// The state of every generator, only the one that is used matters
+typedef struct {
+	unsigned int libc;
+	uint64_t xoshiro[4];
+	// Four xoshiro streams next to each other, indexed [word][lane] so each word is one vector
+	uint64_t lanes[4][4];
+	uint64_t pcgState;
+	uint64_t pcgIncrement;
+} GeneratorState;
+
+typedef struct {
+	const Options *options;
+	GeneratorState state;
+	size_t count;
+	uint64_t *raw;
+	int64_t *values;
+	char *output;
+	size_t outputLength;
+} BlockJob;
+
+uint64_t rotateLeft(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+// splitmix64 turns one seed into well mixed starting states
+uint64_t splitmix64(uint64_t *x) {
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+uint64_t nextXoshiro(uint64_t s[4]) {
+	uint64_t result = rotateLeft(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotateLeft(s[3], 45);
+
+	return result;
+}
+
+// Move a xoshiro256** stream 2^128 numbers ahead, so streams that are jumped apart never overlap
+void jumpXoshiro(uint64_t s[4]) {
+	static const uint64_t jump[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+	uint64_t result[4] = {0, 0, 0, 0};
+
+	for (int i = 0; i < 4; i++) {
+		for (int bit = 0; bit < 64; bit++) {
+			if (jump[i] & (1ULL << bit)) {
+				for (int word = 0; word < 4; word++) {
+					result[word] ^= s[word];
+				}
+			}
+			nextXoshiro(s);
+		}
+	}
+	memcpy(s, result, sizeof(result));
+}
+
+uint32_t nextPcg32(uint64_t *state, uint64_t increment) {
+	uint64_t old = *state;
+	*state = old * 6364136223846793005ULL + increment;
+	uint32_t xorShifted = ((old >> 18) ^ old) >> 27;
+	uint32_t rotation = old >> 59;
+	return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+}
+
+// Move a PCG stream ahead by any amount of draws in log(delta) steps
+void advancePcg(uint64_t *state, uint64_t increment, uint64_t delta) {
+	uint64_t multiplier = 6364136223846793005ULL;
+	uint64_t accumulatedMultiplier = 1, accumulatedIncrement = 0;
+
+	while (delta > 0) {
+		if (delta & 1) {
+			accumulatedMultiplier *= multiplier;
+			accumulatedIncrement = accumulatedIncrement * multiplier + increment;
+		}
+		increment = (multiplier + 1) * increment;
+		multiplier *= multiplier;
+		delta /= 2;
+	}
+	*state = accumulatedMultiplier * *state + accumulatedIncrement;
+}
+
+// The state of the first block for a seed
+GeneratorState createGeneratorState(uint64_t seed) {
+	GeneratorState state;
+	uint64_t mixer = seed;
+
+	state.libc = seed;
+	for (int word = 0; word < 4; word++) {
+		state.xoshiro[word] = splitmix64(&mixer);
+	}
+	state.pcgIncrement = splitmix64(&mixer) | 1;
+	state.pcgState = splitmix64(&mixer);
+	return state;
+}
+
+// Move the state on to the next block, so every block has a stream that only depends on the seed and the block number
+void advanceToNextBlock(GeneratorState *state, int generator) {
+	switch (generator) {
+		case GeneratorLibc:
+			// rand_r can't jump, so every block gets its own seed instead
+			state->libc += 0x9e3779b9u;
+			break;
+		case GeneratorXoshiro:
+			jumpXoshiro(state->xoshiro);
+			break;
+		case GeneratorPcg:
+			advancePcg(&state->pcgState, state->pcgIncrement, PCG_BLOCK_DISTANCE);
+			break;
+		case GeneratorXoshiroX4:
+			// Each block uses four jumps, one for every lane
+			for (int lane = 0; lane < 4; lane++) {
+				jumpXoshiro(state->xoshiro);
+			}
+			break;
+	}
+}
+
+// Fill raw with 64 random bits per number from the block's stream
+void generateRaw(GeneratorState *state, int generator, uint64_t *raw, size_t count) {
+	switch (generator) {
+		case GeneratorLibc:
+			for (size_t i = 0; i < count; i++) {
+				// rand_r only gives 31 bits at a time
+				uint64_t high = rand_r(&state->libc);
+				uint64_t middle = rand_r(&state->libc);
+				uint64_t low = rand_r(&state->libc);
+				raw[i] = (high << 33) ^ (middle << 2) ^ low;
+			}
+			break;
+		case GeneratorXoshiro:
+			for (size_t i = 0; i < count; i++) {
+				raw[i] = nextXoshiro(state->xoshiro);
+			}
+			break;
+		case GeneratorPcg:
+			for (size_t i = 0; i < count; i++) {
+				uint64_t high = nextPcg32(&state->pcgState, state->pcgIncrement);
+				raw[i] = (high << 32) | nextPcg32(&state->pcgState, state->pcgIncrement);
+			}
+			break;
+		case GeneratorXoshiroX4: {
+			// Spread the jumped streams over the lanes
+			uint64_t (*s)[4] = state->lanes;
+			for (int lane = 0; lane < 4; lane++) {
+				for (int word = 0; word < 4; word++) {
+					s[word][lane] = state->xoshiro[word];
+				}
+				jumpXoshiro(state->xoshiro);
+			}
+
+			// Every step updates all four lanes the same way, which the compiler turns into vector instructions
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4) {
+				for (int lane = 0; lane < 4; lane++) {
+					uint64_t x = s[1][lane] * 5;
+					raw[i + lane] = ((x << 7) | (x >> 57)) * 9;
+					uint64_t t = s[1][lane] << 17;
+					s[2][lane] ^= s[0][lane];
+					s[3][lane] ^= s[1][lane];
+					s[1][lane] ^= s[2][lane];
+					s[0][lane] ^= s[3][lane];
+					s[2][lane] ^= t;
+					s[3][lane] = (s[3][lane] << 45) | (s[3][lane] >> 19);
+				}
+			}
+			for (int lane = 0; i < count; i++, lane++) {
+				uint64_t laneState[4] = {s[0][lane], s[1][lane], s[2][lane], s[3][lane]};
+				raw[i] = nextXoshiro(laneState);
+			}
+			break;
+		}
+	}
+}
+
+// Turn the random bits into numbers between min and max
+void mapValues(const Options *options, const uint64_t *raw, int64_t *values, size_t count) {
+	uint64_t range = (uint64_t)options->max - (uint64_t)options->min + 1;
+
+	if (options->distribution == DistributionUniform) {
+		for (size_t i = 0; i < count; i++) {
+			// Multiply and keep the high half instead of a modulo, a full range of 2^64 wraps to 0
+			uint64_t offset = range == 0 ? raw[i] : (uint64_t)(((unsigned __int128)raw[i] * range) >> 64);
+			values[i] = (int64_t)((uint64_t)options->min + offset);
+		}
+		return;
+	}
+
+	// Normal distribution around the middle of the range, with 3 standard deviations to each side
+	double mean = ((double)options->min + (double)options->max) / 2;
+	double deviation = ((double)options->max - (double)options->min) / 6;
+
+	for (size_t i = 0; i < count; i += 2) {
+		// Box-Muller turns two uniform numbers into two normal ones
+		double u1 = ((raw[i] >> 11) + 1) * 0x1.0p-53;
+		double u2 = (raw[i + 1 < count ? i + 1 : i] >> 11) * 0x1.0p-53;
+		double radius = sqrt(-2 * log(u1));
+		double normals[2] = {radius * cos(2 * M_PI * u2), radius * sin(2 * M_PI * u2)};
+
+		for (size_t j = 0; j < 2 && i + j < count; j++) {
+			double value = round(mean + normals[j] * deviation);
+
+			// Keep the rare values outside the range at its edges. Compare as integers, a max near INT64_MAX
+			// rounds up to 2^63 as a double, which no longer fits an int64_t.
+			int64_t number;
+			if (value >= 0x1.0p63) {
+				number = options->max;
+			} else if (value < -0x1.0p63) {
+				number = options->min;
+			} else {
+				number = (int64_t)value;
+			}
+			if (number < options->min) number = options->min;
+			if (number > options->max) number = options->max;
+			values[i + j] = number;
+		}
+	}
+}
+
+// Write a number two digits at a time, returns the amount of characters written
+size_t formatNumber(char *out, int64_t value) {
+	static const char digitPairs[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+	char digits[24];
+	int position = sizeof(digits);
+	uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+
+	while (magnitude >= 100) {
+		position -= 2;
+		memcpy(digits + position, digitPairs + magnitude % 100 * 2, 2);
+		magnitude /= 100;
+	}
+	if (magnitude >= 10) {
+		position -= 2;
+		memcpy(digits + position, digitPairs + magnitude * 2, 2);
+	} else {
+		digits[--position] = '0' + magnitude;
+	}
+	if (value < 0) {
+		digits[--position] = '-';
+	}
+
+	memcpy(out, digits + position, sizeof(digits) - position);
+	return sizeof(digits) - position;
+}
+
+void *runBlockJob(void *argument) {
+	BlockJob *job = argument;
+	const Options *options = job->options;
+
+	generateRaw(&job->state, options->generator, job->raw, job->count);
+
+	// Binary numbers are already in their final form, so map them straight into the output
+	if (options->format == FormatBinary) {
+		mapValues(options, job->raw, (int64_t *)job->output, job->count);
+		job->outputLength = job->count * sizeof(int64_t);
+		return NULL;
+	}
+
+	mapValues(options, job->raw, job->values, job->count);
+
+	char *out = job->output;
+	for (size_t i = 0; i < job->count; i++) {
+		out += formatNumber(out, job->values[i]);
+		*out++ = '\n';
+	}
+	job->outputLength = out - job->output;
+	return NULL;
+}
+
+// Generate all numbers and hand them to the file in order, returns the amount of bytes.
+// Each round every thread generates one block, so the output is the same for any amount of threads.
+long long generateNumbers(const Options *options, FILE *file) {
+	pthread_t threads[MAX_THREADS];
+	BlockJob jobs[MAX_THREADS];
+	GeneratorState state = createGeneratorState(options->seed);
+	long long remaining = options->count;
+	long long totalBytes = 0;
+
+	for (int i = 0; i < options->threadCount; i++) {
+		jobs[i].options = options;
+		jobs[i].raw = malloc(BLOCK_SZ * sizeof(uint64_t));
+		jobs[i].values = malloc(BLOCK_SZ * sizeof(int64_t));
+		jobs[i].output = malloc(BLOCK_SZ * MAX_NUMBER_TEXT);
+		if (jobs[i].raw == NULL || jobs[i].values == NULL || jobs[i].output == NULL) {
+			fprintf(stderr, "Memory allocation failed.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	while (remaining > 0) {
+		int started = 0;
+		for (; started < options->threadCount && remaining > 0; started++) {
+			BlockJob *job = &jobs[started];
+			job->count = remaining < BLOCK_SZ ? remaining : BLOCK_SZ;
+			job->state = state;
+			advanceToNextBlock(&state, options->generator);
+			remaining -= job->count;
+
+			if (options->threadCount == 1) {
+				runBlockJob(job);
+			} else {
+				pthread_create(&threads[started], NULL, runBlockJob, job);
+			}
+		}
+
+		// Write the blocks in the order they were started
+		for (int i = 0; i < started; i++) {
+			if (options->threadCount > 1) {
+				pthread_join(threads[i], NULL);
+			}
+			if (file != NULL && fwrite(jobs[i].output, 1, jobs[i].outputLength, file) != jobs[i].outputLength) {
+				fprintf(stderr, "Failed to write output.\n");
+				exit(EXIT_FAILURE);
+			}
+			totalBytes += jobs[i].outputLength;
+		}
+	}
+
+	for (int i = 0; i < options->threadCount; i++) {
+		free(jobs[i].raw);
+		free(jobs[i].values);
+		free(jobs[i].output);
+	}
+	return totalBytes;
+}
+
+double getMonotonicSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Measure every generator without writing anything
+void runBenchmark(Options options) {
+	printf("%-12s %12s %10s %10s\n", "generator", "numbers", "seconds", "GB/s");
+
+	for (int generator = 0; generator < GENERATOR_COUNT; generator++) {
+		options.generator = generator;
+
+		double startTime = getMonotonicSeconds();
+		long long bytes = generateNumbers(&options, NULL);
+		double elapsed = getMonotonicSeconds() - startTime;
+
+		printf("%-12s %12lld %10.3f %10.3f\n", generatorNames[generator], options.count, elapsed, bytes / elapsed / 1e9);
+		fflush(stdout);
+	}
+}
+
+void printUsage(const char *program) {
+	fprintf(stderr, "Usage: %s [options]\n", program);
+	fprintf(stderr, "Without options a single random number is printed.\n");
+	fprintf(stderr, "  --count N                 Amount of numbers to generate\n");
+	fprintf(stderr, "  --generator NAME          libc, xoshiro, pcg or xoshiro-x4 (default xoshiro)\n");
+	fprintf(stderr, "  --min A --max B           Range of the numbers (default 0 to %d)\n", RAND_MAX);
+	fprintf(stderr, "  --distribution NAME       uniform or normal (default uniform)\n");
+	fprintf(stderr, "  --binary                  Write 64 bit integers instead of text lines\n");
+	fprintf(stderr, "  --seed S                  Seed, the same seed gives the same numbers for any thread count\n");
+	fprintf(stderr, "  --threads T               Generate blocks on T threads\n");
+	fprintf(stderr, "  --output FILE             Write to a file instead of stdout\n");
+	fprintf(stderr, "  --bench                   Measure GB/s of every generator instead of writing\n");
+}
+
+int main(int argc, char *argv[]) {
+	if (argc == 1) {
+		srand(time(NULL));
+		int randomNumber = rand();
+
+		printf("Random number: %d\n", randomNumber);
+		return 0;
+	}
+
+	Options options;
+	options.generator = GeneratorXoshiro;
+	options.distribution = DistributionUniform;
+	options.format = FormatText;
+	options.min = 0;
+	options.max = RAND_MAX;
+	options.seed = time(NULL);
+	options.count = -1;
+	options.threadCount = 1;
+	const char *path = NULL;
+	int isBenchmark = 0;
+
+	for (int i = 1; i < argc; i++) {
+		int hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--count") == 0 && hasValue) {
+			options.count = atoll(argv[++i]);
+		} else if (strcmp(argv[i], "--generator") == 0 && hasValue) {
+			i++;
+			options.generator = -1;
+			for (int generator = 0; generator < GENERATOR_COUNT; generator++) {
+				if (strcmp(argv[i], generatorNames[generator]) == 0) {
+					options.generator = generator;
+				}
+			}
+			if (options.generator < 0) {
+				printUsage(argv[0]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--min") == 0 && hasValue) {
+			options.min = atoll(argv[++i]);
+		} else if (strcmp(argv[i], "--max") == 0 && hasValue) {
+			options.max = atoll(argv[++i]);
+		} else if (strcmp(argv[i], "--distribution") == 0 && hasValue) {
+			i++;
+			if (strcmp(argv[i], "uniform") == 0) {
+				options.distribution = DistributionUniform;
+			} else if (strcmp(argv[i], "normal") == 0) {
+				options.distribution = DistributionNormal;
+			} else {
+				printUsage(argv[0]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--binary") == 0) {
+			options.format = FormatBinary;
+		} else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+			options.seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+			options.threadCount = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+			path = argv[++i];
+		} else if (strcmp(argv[i], "--bench") == 0) {
+			isBenchmark = 1;
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (options.min > options.max || options.threadCount < 1 || options.threadCount > MAX_THREADS) {
+		fprintf(stderr, "The minimum can't be above the maximum and threads must be between 1 and %d.\n", MAX_THREADS);
+		return 1;
+	}
+
+	if (isBenchmark) {
+		if (options.count < 0) {
+			options.count = 1 << 26;
+		}
+		runBenchmark(options);
+		return 0;
+	}
+
+	if (options.count < 0) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	FILE *file = path != NULL ? fopen(path, "wb") : stdout;
+	if (file == NULL) {
+		perror(path);
+		return 1;
+	}
+
+	// Let the blocks go straight to the file instead of through the small stdio buffer
+	setvbuf(file, NULL, _IONBF, 0);
+
+	double startTime = getMonotonicSeconds();
+	long long bytes = generateNumbers(&options, file);
+	double elapsed = getMonotonicSeconds() - startTime;
+
+	fprintf(stderr, "%lld numbers (%lld bytes) with %s and seed %llu in %.3f seconds, %.3f GB/s\n",
+		options.count, bytes, generatorNames[options.generator], (unsigned long long)options.seed, elapsed, bytes / elapsed / 1e9);
+
+	if (file != stdout) {
+		fclose(file);
+	}
+	return 0;
 }
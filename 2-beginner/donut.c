@@ -1,21 +1,272 @@
-             k;double sin()
-         ,cos();main(){float A=
-       0,B=0,i,j,z[1760];char b[
-     1760];printf("\x1b[2J");for(;;
-  ){memset(b,32,1760);memset(z,0,7040)
-  ;for(j=0;6.28>j;j+=0.01)for(i=0;6.28
- >i;i+=0.02){float c=sin(i),d=cos(j),e=
- sin(A),f=sin(j),g=cos(A),h=d+2,D=1/(c*
- h*e+f*g+5),l=cos      (i),m=cos(B),n=s\
-in(B),t=c*h*g-f*        e;int x=40+30*D*
-(l*h*m-t*n),y=            12+15*D*(l*h*n
-+t*m),o=x+80*y,          N=8*((f*e-c*d*g
- )*m-c*d*e-f*g-l        *d*n);if(22>y&&
- y>0&&x>0&&80>x&&D>z[o]){z[o]=D;;;b[o]=
- ".,-~:;=!*#$@"[N>0?N:0];}}/*#****!!-*/
-  printf("\x1b[H");for(k=0;1761>k;k++)
-   putchar(k%80?b[k]:10);A+=0.04;B+=
-     0.02;}}/*****####*******!!=;:~
-       ~::==!!!**********!!!==::-
-         .,~~;;;========;;;:~-.
-             ..,--------,*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// The donut is rendered into a fixed 80x22 character screen
+#define SCREEN_WIDTH 80
+#define SCREEN_HEIGHT 22
+#define SCREEN_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT)
+
+// One frame of text is a newline followed by each row, exactly like the original donut
+#define FRAME_TEXT_SIZE (SCREEN_SIZE + 1)
+
+// Size of the buffer used to batch up writes to the output file
+#define OUTPUT_BUFFER_SZ (1 << 20)
+
+// The characters used for the luminance, from darkest to brightest
+const char *luminanceChars = ".,-~:;=!*#$@";
+
+enum OutputFormat {
+	FormatNone,
+	FormatRaw,
+	FormatCast,
+};
+
+typedef struct {
+	char *data;
+	size_t length;
+	size_t capacity;
+	size_t totalWritten;
+	FILE *file;
+} OutputBuffer;
+
+OutputBuffer createOutputBuffer(FILE *file) {
+	OutputBuffer buffer;
+	buffer.data = malloc(OUTPUT_BUFFER_SZ);
+	if (buffer.data == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+	buffer.length = 0;
+	buffer.capacity = OUTPUT_BUFFER_SZ;
+	buffer.totalWritten = 0;
+	buffer.file = file;
+	return buffer;
+}
+
+// Write everything collected so far to the file in one go
+void flushOutputBuffer(OutputBuffer *buffer) {
+	if (buffer->length == 0) return;
+
+	if (buffer->file != NULL && fwrite(buffer->data, 1, buffer->length, buffer->file) != buffer->length) {
+		fprintf(stderr, "Failed to write output.\n");
+		exit(EXIT_FAILURE);
+	}
+	buffer->totalWritten += buffer->length;
+	buffer->length = 0;
+}
+
+void appendBytes(OutputBuffer *buffer, const char *bytes, size_t count) {
+	// Make room if the bytes don't fit anymore
+	if (buffer->length + count > buffer->capacity) {
+		flushOutputBuffer(buffer);
+	}
+
+	// Bytes larger than the whole buffer are written directly
+	if (count > buffer->capacity) {
+		if (buffer->file != NULL) fwrite(bytes, 1, count, buffer->file);
+		buffer->totalWritten += count;
+		return;
+	}
+
+	memcpy(buffer->data + buffer->length, bytes, count);
+	buffer->length += count;
+}
+
+void appendString(OutputBuffer *buffer, const char *str) {
+	appendBytes(buffer, str, strlen(str));
+}
+
+void freeOutputBuffer(OutputBuffer *buffer) {
+	flushOutputBuffer(buffer);
+	free(buffer->data);
+}
+
+double getMonotonicSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Render one frame of the donut rotated by A and B.
+// Every cell of luminance gets 0 for empty space or 1-12 for the brightness of the surface.
+void renderFrame(unsigned char luminance[], float zbuffer[], float A, float B) {
+	memset(luminance, 0, SCREEN_SIZE);
+	memset(zbuffer, 0, SCREEN_SIZE * sizeof(float));
+
+	float cosA = cos(A), sinA = sin(A);
+	float cosB = cos(B), sinB = sin(B);
+
+	// Walk around the cross section of the torus (j) and around the torus itself (i)
+	for (float j = 0; 6.28 > j; j += 0.01) {
+		float cosJ = cos(j), sinJ = sin(j);
+		float circleX = cosJ + 2;
+
+		for (float i = 0; 6.28 > i; i += 0.02) {
+			float sinI = sin(i), cosI = cos(i);
+
+			// One over the distance to the viewer
+			float depth = 1 / (sinI * circleX * sinA + sinJ * cosA + 5);
+			float t = sinI * circleX * cosA - sinJ * sinA;
+
+			// Project onto the screen
+			int x = 40 + 30 * depth * (cosI * circleX * cosB - t * sinB);
+			int y = 12 + 15 * depth * (cosI * circleX * sinB + t * cosB);
+			int offset = x + SCREEN_WIDTH * y;
+
+			// Surface normal dotted with the light direction
+			int brightness = 8 * ((sinJ * sinA - sinI * cosJ * cosA) * cosB - sinI * cosJ * sinA - sinJ * cosA - cosI * cosJ * sinB);
+
+			// Only draw the point if it is on screen and closer than what is already there
+			if (SCREEN_HEIGHT > y && y > 0 && x > 0 && SCREEN_WIDTH > x && depth > zbuffer[offset]) {
+				zbuffer[offset] = depth;
+				luminance[offset] = (brightness > 0 ? brightness : 0) + 1;
+			}
+		}
+	}
+}
+
+// Turn the luminance of a frame into the text that is printed to the terminal
+void frameToText(char text[], const unsigned char luminance[]) {
+	// The first column of every row is replaced by a new line, plus one trailing new line
+	for (int k = 0; k < FRAME_TEXT_SIZE; k++) {
+		if (k % SCREEN_WIDTH == 0) {
+			text[k] = '\n';
+		} else {
+			text[k] = luminance[k] ? luminanceChars[luminance[k] - 1] : ' ';
+		}
+	}
+}
+
+// Append a frame as an asciicast v2 event, the text needs no escaping except for new lines
+void appendCastFrame(OutputBuffer *buffer, const char text[], int frame) {
+	char header[64];
+	snprintf(header, sizeof(header), "[%.6f, \"o\", \"\\u001b[H", frame / 30.0);
+	appendString(buffer, header);
+
+	int rowStart = 0;
+	for (int k = 0; k < FRAME_TEXT_SIZE; k++) {
+		if (text[k] != '\n') continue;
+		appendBytes(buffer, text + rowStart, k - rowStart);
+		appendString(buffer, "\\r\\n");
+		rowStart = k + 1;
+	}
+	appendString(buffer, "\"]\n");
+}
+
+void runInteractive() {
+	unsigned char luminance[SCREEN_SIZE];
+	float zbuffer[SCREEN_SIZE];
+	char text[FRAME_TEXT_SIZE];
+	float A = 0, B = 0;
+
+	// Clear the screen once
+	printf("\x1b[2J");
+
+	for (;;) {
+		renderFrame(luminance, zbuffer, A, B);
+		frameToText(text, luminance);
+
+		// Move the cursor home and draw the whole frame
+		printf("\x1b[H");
+		fwrite(text, 1, FRAME_TEXT_SIZE, stdout);
+
+		A += 0.04;
+		B += 0.02;
+	}
+}
+
+// Render a fixed amount of frames without touching the terminal and report the throughput
+void runHeadless(long frames, int format, FILE *file) {
+	unsigned char luminance[SCREEN_SIZE];
+	float zbuffer[SCREEN_SIZE];
+	char text[FRAME_TEXT_SIZE];
+	float A = 0, B = 0;
+
+	OutputBuffer buffer = createOutputBuffer(file);
+
+	if (format == FormatCast) {
+		appendString(&buffer, "{\"version\": 2, \"width\": 80, \"height\": 23}\n");
+	}
+
+	double startTime = getMonotonicSeconds();
+
+	for (long frame = 0; frame < frames; frame++) {
+		renderFrame(luminance, zbuffer, A, B);
+
+		if (format == FormatRaw) {
+			appendBytes(&buffer, (const char *)luminance, SCREEN_SIZE);
+		} else if (format == FormatCast) {
+			frameToText(text, luminance);
+			appendCastFrame(&buffer, text, frame);
+		}
+
+		A += 0.04;
+		B += 0.02;
+	}
+
+	freeOutputBuffer(&buffer);
+
+	double elapsed = getMonotonicSeconds() - startTime;
+
+	// Report on stderr so the frames can be streamed to stdout
+	fprintf(stderr, "Frames: %ld in %.3f seconds\n", frames, elapsed);
+	fprintf(stderr, "Frames/second: %.1f\n", frames / elapsed);
+	fprintf(stderr, "Bytes/second: %.1f\n", buffer.totalWritten / elapsed);
+}
+
+void printUsage(const char *program) {
+	fprintf(stderr, "Usage: %s [--frames N [--raw FILE | --cast FILE]]\n", program);
+	fprintf(stderr, "  --frames N   Render N frames headless and print frames/second\n");
+	fprintf(stderr, "  --raw FILE   Stream one luminance byte per cell (0 = empty, 1-12) per frame\n");
+	fprintf(stderr, "  --cast FILE  Stream the frames as an asciicast v2 log\n");
+	fprintf(stderr, "Use - as FILE to write to stdout.\n");
+}
+
+int main(int argc, char *argv[]) {
+	long frames = -1;
+	int format = FormatNone;
+	const char *path = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frames = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--raw") == 0 && i + 1 < argc) {
+			format = FormatRaw;
+			path = argv[++i];
+		} else if (strcmp(argv[i], "--cast") == 0 && i + 1 < argc) {
+			format = FormatCast;
+			path = argv[++i];
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	// Without a frame count the donut spins in the terminal forever
+	if (frames < 0) {
+		if (format != FormatNone) {
+			printUsage(argv[0]);
+			return 1;
+		}
+		runInteractive();
+	}
+
+	FILE *file = NULL;
+	if (path != NULL) {
+		file = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+		if (file == NULL) {
+			perror(path);
+			return 1;
+		}
+	}
+
+	runHeadless(frames, format, file);
+
+	if (file != NULL && file != stdout) {
+		fclose(file);
+	}
+	return 0;
+}
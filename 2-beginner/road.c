@@ -1,65 +1,151 @@
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <signal.h>
 #include <stdbool.h>
 
-/* msleep(): Sleep for the requested number of milliseconds. */
-int msleep(long msec)
-{
-    struct timespec ts;
-    int res;
+#define NSEC_PER_SEC 1000000000L
 
-    if (msec < 0)
-    {
-        errno = EINVAL;
-        return -1;
-    }
+// Amount of characters per row, not counting the new line
+#define ROW_WIDTH 90
 
-    ts.tv_sec = msec / 1000;
-    ts.tv_nsec = (msec % 1000) * 1000000;
+char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
 
-    do {
-        res = nanosleep(&ts, &ts);
-    } while (res && errno == EINTR);
+// The alphabet repeated often enough that any rotation of it covers a whole row
+char repeatedAlphabet[26 + ROW_WIDTH];
 
-    return res;
-}
+// The row is allocated once and reused for every frame
+char row[ROW_WIDTH + 1];
 
-char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+volatile sig_atomic_t isRunning = true;
+
+typedef struct {
+	struct timespec deadline;
+	long frames;
+	long missedDeadlines;
+	double totalJitter;
+	double maxJitter;
+} FrameScheduler;
 
-char getChar(int i, int time) {
-	int charIndex = (i + time) % 26;
-	return alphabet[charIndex];
+void handleInterrupt(int signal) {
+	(void)signal;
+	isRunning = false;
 }
 
-void printSegment(int start, int end, int time) {
-	int total = 90;
+long timespecDiffNs(struct timespec a, struct timespec b) {
+	return (a.tv_sec - b.tv_sec) * NSEC_PER_SEC + (a.tv_nsec - b.tv_nsec);
+}
 
-	char* segment = malloc(total + 1);
+void addNs(struct timespec *ts, long ns) {
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= NSEC_PER_SEC) {
+		ts->tv_nsec -= NSEC_PER_SEC;
+		ts->tv_sec++;
+	}
+}
 
-	for (int i = 0; i < start; i++) {
-		segment[i] = getChar(i, time);
+FrameScheduler createFrameScheduler() {
+	FrameScheduler scheduler;
+	clock_gettime(CLOCK_MONOTONIC, &scheduler.deadline);
+	scheduler.frames = 0;
+	scheduler.missedDeadlines = 0;
+	scheduler.totalJitter = 0;
+	scheduler.maxJitter = 0;
+	return scheduler;
+}
+
+/* waitForNextFrame(): Sleep until the absolute deadline of the next frame, so time spent rendering doesn't add up. */
+void waitForNextFrame(FrameScheduler *scheduler, long periodNs) {
+	struct timespec now;
+
+	addNs(&scheduler->deadline, periodNs);
+
+	// If rendering took longer than a whole frame, the deadline is already gone
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double jitter;
+	if (timespecDiffNs(now, scheduler->deadline) > 0) {
+		scheduler->missedDeadlines++;
+		// The late frame counts with how late it is, before the deadline moves
+		jitter = timespecDiffNs(now, scheduler->deadline) / 1e6;
+		// Start over from now instead of rushing out frames to catch up,
+		// this gives up staying drift free for the frames that were missed
+		scheduler->deadline = now;
+	} else {
+		int res;
+		do {
+			res = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &scheduler->deadline, NULL);
+		} while (res == EINTR && isRunning);
+
+		// An interrupted sleep never reached its deadline, so it doesn't count
+		if (!isRunning) return;
+
+		// Measure how late we woke up
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		jitter = timespecDiffNs(now, scheduler->deadline) / 1e6;
 	}
-	for (int i = start; i < end; i++) {
-		segment[i] = ' ';
+
+	scheduler->totalJitter += jitter;
+	if (jitter > scheduler->maxJitter) {
+		scheduler->maxJitter = jitter;
 	}
-	for (int i = end; i < total; i++) {
-		segment[i] = getChar(i, time);
+	scheduler->frames++;
+}
+
+void printSchedulerStats(FrameScheduler scheduler) {
+	if (scheduler.frames == 0) return;
+
+	fprintf(stderr, "Frames: %ld\n", scheduler.frames);
+	fprintf(stderr, "Missed deadlines: %ld\n", scheduler.missedDeadlines);
+	fprintf(stderr, "Average jitter: %.3f ms\n", scheduler.totalJitter / scheduler.frames);
+	fprintf(stderr, "Max jitter: %.3f ms\n", scheduler.maxJitter);
+}
+
+void initRepeatedAlphabet() {
+	for (int i = 0; i < (int)sizeof(repeatedAlphabet); i++) {
+		repeatedAlphabet[i] = alphabet[i % 26];
 	}
+	row[ROW_WIDTH] = '\n';
+}
+
+void printSegment(int start, int end, int time) {
+	// Slide the window over the repeated alphabet instead of calculating every character
+	const char *letters = repeatedAlphabet + time % 26;
 
-	printf("%s\n", segment);
+	memcpy(row, letters, start);
+	memset(row + start, ' ', end - start);
+	memcpy(row + end, letters + end, ROW_WIDTH - end);
+
+	fwrite(row, 1, ROW_WIDTH + 1, stdout);
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+	// With --frames the road is printed that many times as fast as possible
+	long frames = -1;
+	if (argc == 3 && strcmp(argv[1], "--frames") == 0) {
+		frames = atol(argv[2]);
+	} else if (argc != 1) {
+		fprintf(stderr, "Usage: %s [--frames N]\n", argv[0]);
+		return 1;
+	}
+	bool isHeadless = frames >= 0;
+
 	int time = 0;
 	int width = 32;
 	int speed = 15;
 	int maxSpeed = 130;
 	bool isSlowingDown = false;
 
-	for (;;) {
+	initRepeatedAlphabet();
+
+	// Stop the loop on Ctrl+C so the stats can be printed
+	signal(SIGINT, handleInterrupt);
+
+	FrameScheduler scheduler = createFrameScheduler();
+
+	while (isRunning && (!isHeadless || time < frames)) {
 		int x = sin(time / 10.0) * 20 + 28;
 
 		// Increase the time
@@ -67,6 +153,9 @@ int main() {
 
 		// Print the segment
 		printSegment(x, x + width, time);
+		if (!isHeadless) {
+			fflush(stdout);
+		}
 
 		// Change the speed
 		if (isSlowingDown) {
@@ -90,7 +179,12 @@ int main() {
 		}
 
 		// Wait before the next frame
-		msleep(1000 / speed);
+		if (!isHeadless) {
+			waitForNextFrame(&scheduler, NSEC_PER_SEC / speed);
+		}
 	}
-}
 
+	fflush(stdout);
+	printSchedulerStats(scheduler);
+	return 0;
+}
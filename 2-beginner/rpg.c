@@ -211,16 +211,8 @@ void clearScreen() {
 	printf("\033[H\033[J");
 }
 
-int main() {
-	// Seed the random number generator
-	srand(time(NULL));
-
-	// Ask the player what their warriors name should be
-	char playerName[32];
-	printf("Enter your name: ");
-	fgets(playerName, 32, stdin);
-	playerName[strlen(playerName) - 1] = '\0';
-
+// Play one game from level 1 until the player dies
+void playGame(char playerName[], bool isHeadless) {
 	// Create the player and the first enemy
 	Entity player = createPlayer(playerName);
 
@@ -238,7 +230,7 @@ int main() {
 		// The player gets the first turn in each level
 		bool playerTurn = true;
 		while (!isOneDead(player, enemy)) {
-			msleep(2000);
+			if (!isHeadless) msleep(2000);
 
 			clearScreen();
 			printf("*************** %s's turn ***************\n", playerTurn ? player.name : enemy.name);
@@ -268,10 +260,51 @@ int main() {
 			break;
 		}
 
-		msleep(2000);
+		if (!isHeadless) msleep(2000);
 
 		level++;
 	}
+}
+
+int main(int argc, char *argv[]) {
+	// With --headless the game plays itself without waiting and without asking for a name
+	bool isHeadless = false;
+	unsigned int seed = time(NULL);
+	// Games are played one after another so a benchmark run lasts long enough to measure. The seed is only
+	// applied once and every game continues its sequence, so N games together are one deterministic run.
+	int games = 1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			isHeadless = true;
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+			games = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "Usage: %s [--headless] [--seed S] [--games N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (games < 1) {
+		fprintf(stderr, "Games must be at least 1.\n");
+		return 1;
+	}
+
+	// Seed the random number generator
+	srand(seed);
+
+	// Ask the player what their warriors name should be
+	char playerName[32] = "Bench";
+	if (!isHeadless) {
+		printf("Enter your name: ");
+		fgets(playerName, 32, stdin);
+		playerName[strlen(playerName) - 1] = '\0';
+	}
+
+	for (int game = 0; game < games; game++) {
+		playGame(playerName, isHeadless);
+	}
 
 	return 0;
 }
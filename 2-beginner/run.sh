@@ -1,3 +1,3 @@
 # Example ./run.sh struct.c
-gcc $1 -lm
+gcc $1 -lm -pthread
 ./a.out
@@ -1,83 +1,1271 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define MAX_NAME_SZ 32
 
+// Size of the chunks the CSV file is read in
+#define READ_CHUNK_SZ (1 << 20)
+
+// Size of each block of memory the strings are stored in
+#define ARENA_BLOCK_SZ (1 << 20)
+
+// Ages above this are treated as invalid records
+#define MAX_AGE 255
+
+// Formatted sentences are written out once this many bytes are collected
+#define OUTPUT_FLUSH_SZ (1 << 20)
+
+// Amount of people every thread formats per round
+#define FORMAT_BATCH_SZ 65536
+
+#define MAX_THREADS 64
+
+// Identifies the columnar binary format, "PRSN" followed by the version
+#define PERSON_FILE_MAGIC "PRSN"
+#define PERSON_FILE_VERSION 1
+
 typedef struct {
-	char firstName[MAX_NAME_SZ];
-	char lastName[MAX_NAME_SZ];
-	char age[MAX_NAME_SZ];
-	char job[MAX_NAME_SZ];
+	const char *firstName;
+	const char *lastName;
+	int age;
+	const char *job;
 } Person;
 
-Person createPerson(char firstName[], char lastName[], char age[], char job[]) {
+// Block of memory that strings are appended to and never freed one by one
+typedef struct ArenaBlock {
+	struct ArenaBlock *next;
+	size_t used;
+	size_t capacity;
+	char data[];
+} ArenaBlock;
+
+typedef struct {
+	ArenaBlock *head;
+	size_t totalBytes;
+} Arena;
+
+typedef struct {
+	uint32_t hash;
+	uint32_t length;
+	const char *str;
+} InternEntry;
+
+// Hash set that makes sure every distinct string is only stored once
+typedef struct {
+	InternEntry *entries;
+	size_t count;
+	size_t capacity;
+	Arena arena;
+} StringPool;
+
+typedef struct {
+	Person *people;
+	size_t count;
+	size_t capacity;
+	StringPool pool;
+} PersonList;
+
+typedef struct {
+	const char *lastName;
+	int firstPerson;
+} LastNameEntry;
+
+// Hash index from interned last name to a chain of people with that last name
+typedef struct {
+	LastNameEntry *entries;
+	size_t capacity;
+	int *nextWithSameLastName;
+} LastNameIndex;
+
+// People indices sorted by age, so a range of ages is a contiguous slice
+typedef struct {
+	int *order;
+	size_t count;
+} AgeIndex;
+
+enum StringColumn {
+	ColumnFirstName,
+	ColumnLastName,
+	ColumnJob,
+	STRING_COLUMN_COUNT,
+};
+
+// Every person's string is an offset into a blob of distinct null terminated strings
+typedef struct {
+	uint64_t offsetsStart;
+	uint64_t blobStart;
+	uint64_t blobSize;
+} StringColumnHeader;
+
+// Start of a binary person file, all positions are in bytes from the start of the file
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint64_t count;
+	uint64_t agesStart;
+	StringColumnHeader columns[STRING_COLUMN_COUNT];
+} PersonFileHeader;
+
+// A binary person file mapped into memory, all pointers point straight into the mapping
+typedef struct {
+	void *base;
+	size_t size;
+	size_t count;
+	const uint8_t *ages;
+	const uint32_t *offsets[STRING_COLUMN_COUNT];
+	const char *blobs[STRING_COLUMN_COUNT];
+	uint64_t blobSizes[STRING_COLUMN_COUNT];
+} MappedPeople;
+
+// A field slot in a template is one of the string columns or the age
+#define FieldAge STRING_COLUMN_COUNT
+#define SegmentLiteral -1
+
+#define MAX_TEMPLATE_SEGMENTS 16
+
+typedef struct {
+	int field;
+	const char *text;
+	size_t length;
+} TemplateSegment;
+
+// A sentence split once into literal text and field slots, so formatting needs no parsing
+typedef struct {
+	TemplateSegment segments[MAX_TEMPLATE_SEGMENTS];
+	int count;
+} SentenceTemplate;
+
+typedef struct {
+	char *data;
+	size_t length;
+	size_t capacity;
+} TextBuffer;
+
+typedef struct {
+	const SentenceTemplate *sentence;
+	const Person *people;
+	size_t count;
+	TextBuffer *buffer;
+} FormatJob;
+
+void *allocOrDie(size_t size) {
+	void *memory = malloc(size);
+	if (memory == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+	return memory;
+}
+
+double getMonotonicSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+char *arenaAlloc(Arena *arena, size_t size) {
+	// Start a new block if the current one is full
+	if (arena->head == NULL || arena->head->used + size > arena->head->capacity) {
+		size_t capacity = size > ARENA_BLOCK_SZ ? size : ARENA_BLOCK_SZ;
+		ArenaBlock *block = allocOrDie(sizeof(ArenaBlock) + capacity);
+		block->next = arena->head;
+		block->used = 0;
+		block->capacity = capacity;
+		arena->head = block;
+	}
+
+	char *memory = arena->head->data + arena->head->used;
+	arena->head->used += size;
+	arena->totalBytes += size;
+	return memory;
+}
+
+void freeArena(Arena *arena) {
+	while (arena->head != NULL) {
+		ArenaBlock *next = arena->head->next;
+		free(arena->head);
+		arena->head = next;
+	}
+	arena->totalBytes = 0;
+}
+
+// FNV-1a hash of a string that is not null terminated
+uint32_t hashString(const char *str, size_t length) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+StringPool createStringPool() {
+	StringPool pool;
+	pool.capacity = 1024;
+	pool.count = 0;
+	pool.entries = calloc(pool.capacity, sizeof(InternEntry));
+	if (pool.entries == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+	pool.arena.head = NULL;
+	pool.arena.totalBytes = 0;
+	return pool;
+}
+
+void growStringPool(StringPool *pool) {
+	size_t newCapacity = pool->capacity * 2;
+	InternEntry *newEntries = calloc(newCapacity, sizeof(InternEntry));
+	if (newEntries == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Move every string to its slot in the bigger table
+	for (size_t i = 0; i < pool->capacity; i++) {
+		InternEntry entry = pool->entries[i];
+		if (entry.str == NULL) continue;
+
+		size_t slot = entry.hash & (newCapacity - 1);
+		while (newEntries[slot].str != NULL) {
+			slot = (slot + 1) & (newCapacity - 1);
+		}
+		newEntries[slot] = entry;
+	}
+
+	free(pool->entries);
+	pool->entries = newEntries;
+	pool->capacity = newCapacity;
+}
+
+// Return the one stored copy of the string, adding it to the pool if it's new
+const char *internString(StringPool *pool, const char *str, size_t length) {
+	// Keep the table at most 70% full
+	if ((pool->count + 1) * 10 > pool->capacity * 7) {
+		growStringPool(pool);
+	}
+
+	uint32_t hash = hashString(str, length);
+	size_t slot = hash & (pool->capacity - 1);
+
+	while (pool->entries[slot].str != NULL) {
+		InternEntry *entry = &pool->entries[slot];
+		if (entry->hash == hash && entry->length == length && memcmp(entry->str, str, length) == 0) {
+			return entry->str;
+		}
+		slot = (slot + 1) & (pool->capacity - 1);
+	}
+
+	// Copy the string into the arena with a null terminator
+	char *copy = arenaAlloc(&pool->arena, length + 1);
+	memcpy(copy, str, length);
+	copy[length] = '\0';
+
+	pool->entries[slot].hash = hash;
+	pool->entries[slot].length = length;
+	pool->entries[slot].str = copy;
+	pool->count++;
+
+	return copy;
+}
+
+void freeStringPool(StringPool *pool) {
+	free(pool->entries);
+	freeArena(&pool->arena);
+}
+
+PersonList createPersonList() {
+	PersonList list;
+	list.capacity = 1024;
+	list.count = 0;
+	list.people = allocOrDie(list.capacity * sizeof(Person));
+	list.pool = createStringPool();
+	return list;
+}
+
+void addPerson(PersonList *list, Person person) {
+	if (list->count == list->capacity) {
+		list->capacity *= 2;
+		Person *people = realloc(list->people, list->capacity * sizeof(Person));
+		if (people == NULL) {
+			fprintf(stderr, "Memory allocation failed.\n");
+			exit(EXIT_FAILURE);
+		}
+		list->people = people;
+	}
+	list->people[list->count++] = person;
+}
+
+void freePersonList(PersonList *list) {
+	free(list->people);
+	freeStringPool(&list->pool);
+}
+
+Person createPerson(StringPool *pool, char firstName[], char lastName[], int age, char job[]) {
 	Person person;
-	strcpy(person.firstName, firstName);
-	strcpy(person.lastName, lastName);
-	strcpy(person.age, age);
-	strcpy(person.job, job);
+	person.firstName = internString(pool, firstName, strlen(firstName));
+	person.lastName = internString(pool, lastName, strlen(lastName));
+	person.age = age;
+	person.job = internString(pool, job, strlen(job));
 	return person;
 }
 
 // Print information about a person
-void printAboutMe(Person person) {
-	printf("My name is %s %s, I am %s years old and I work as a %s.\n", person.firstName, person.lastName, person.age, person.job);
+void printAboutMe(const Person *person) {
+	printf("My name is %s %s, I am %d years old and I work as a %s.\n", person->firstName, person->lastName, person->age, person->job);
 }
 
 // Print information about a person in the perspective of the user
-void printAboutYou(Person person) {
-	printf("Your name is %s %s, you are %s years old and you work as a %s.\n", person.firstName, person.lastName, person.age, person.job);
+void printAboutYou(const Person *person) {
+	printf("Your name is %s %s, you are %d years old and you work as a %s.\n", person->firstName, person->lastName, person->age, person->job);
+}
+
+// Parse a non-negative age, returns -1 if it isn't a valid age
+int parseAge(const char *str, size_t length) {
+	if (length == 0 || length > 3) return -1;
+
+	int age = 0;
+	for (size_t i = 0; i < length; i++) {
+		if (str[i] < '0' || str[i] > '9') return -1;
+		age = age * 10 + (str[i] - '0');
+	}
+	return age <= MAX_AGE ? age : -1;
+}
+
+// Parse one "firstName,lastName,age,job" line, returns 0 if the line is malformed
+int parseCsvLine(PersonList *list, const char *line, size_t length) {
+	const char *fields[4];
+	size_t lengths[4];
+	const char *end = line + length;
+	const char *cursor = line;
+
+	// Ignore the carriage return of windows line endings
+	if (length > 0 && end[-1] == '\r') end--;
+
+	// Split the line at the commas without copying anything
+	for (int field = 0; field < 4; field++) {
+		const char *comma = field < 3 ? memchr(cursor, ',', end - cursor) : end;
+		if (comma == NULL) return 0;
+
+		fields[field] = cursor;
+		lengths[field] = comma - cursor;
+		cursor = comma + 1;
+	}
+
+	int age = parseAge(fields[2], lengths[2]);
+	if (age < 0) return 0;
+
+	Person person;
+	person.firstName = internString(&list->pool, fields[0], lengths[0]);
+	person.lastName = internString(&list->pool, fields[1], lengths[1]);
+	person.age = age;
+	person.job = internString(&list->pool, fields[3], lengths[3]);
+	addPerson(list, person);
+	return 1;
+}
+
+// Load every person from a CSV file, reading it in large chunks
+size_t loadCsv(PersonList *list, const char *path) {
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	char *buffer = allocOrDie(READ_CHUNK_SZ);
+	size_t carried = 0;
+	size_t invalidLines = 0;
+
+	for (;;) {
+		size_t bytesRead = fread(buffer + carried, 1, READ_CHUNK_SZ - carried, file);
+		size_t available = carried + bytesRead;
+		int isLastChunk = bytesRead == 0;
+
+		if (available == 0) break;
+
+		// Handle every complete line in the chunk
+		char *lineStart = buffer;
+		char *bufferEnd = buffer + available;
+		for (;;) {
+			char *newLine = memchr(lineStart, '\n', bufferEnd - lineStart);
+			if (newLine == NULL) break;
+
+			if (newLine > lineStart && !parseCsvLine(list, lineStart, newLine - lineStart)) {
+				invalidLines++;
+			}
+			lineStart = newLine + 1;
+		}
+
+		carried = bufferEnd - lineStart;
+
+		// The last line of the file might not end with a new line
+		if (isLastChunk) {
+			if (carried > 0 && !parseCsvLine(list, lineStart, carried)) {
+				invalidLines++;
+			}
+			break;
+		}
+
+		if (carried == READ_CHUNK_SZ) {
+			fprintf(stderr, "Line longer than %d bytes in %s.\n", READ_CHUNK_SZ, path);
+			exit(EXIT_FAILURE);
+		}
+
+		// Move the incomplete line to the start for the next chunk
+		memmove(buffer, lineStart, carried);
+	}
+
+	free(buffer);
+	fclose(file);
+	return invalidLines;
+}
+
+// Fibonacci hashing spreads neighbouring addresses over the whole table
+size_t hashPointer(const void *pointer) {
+	return ((uint64_t)(uintptr_t)pointer * 11400714819323198485ull) >> 32;
+}
+
+LastNameIndex buildLastNameIndex(const PersonList *list) {
+	LastNameIndex index;
+
+	// Enough slots to keep the table at most half full
+	index.capacity = 16;
+	while (index.capacity < list->pool.count * 2) {
+		index.capacity *= 2;
+	}
+	index.entries = calloc(index.capacity, sizeof(LastNameEntry));
+	if (index.entries == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+	index.nextWithSameLastName = allocOrDie((list->count + 1) * sizeof(int));
+
+	// Insert backwards so every chain lists people in file order
+	for (size_t i = list->count; i-- > 0;) {
+		const char *lastName = list->people[i].lastName;
+
+		// Interned strings are equal exactly when their pointers are equal
+		size_t slot = hashPointer(lastName) & (index.capacity - 1);
+		while (index.entries[slot].lastName != NULL && index.entries[slot].lastName != lastName) {
+			slot = (slot + 1) & (index.capacity - 1);
+		}
+
+		if (index.entries[slot].lastName == NULL) {
+			index.entries[slot].lastName = lastName;
+			index.nextWithSameLastName[i] = -1;
+		} else {
+			index.nextWithSameLastName[i] = index.entries[slot].firstPerson;
+		}
+		index.entries[slot].firstPerson = i;
+	}
+
+	return index;
+}
+
+// Returns the first person with the last name, or -1. Use nextWithSameLastName for the rest.
+int findByLastName(const LastNameIndex *index, StringPool *pool, const char *lastName) {
+	// Look up the interned copy, a name that was never interned can't be in the index
+	uint32_t hash = hashString(lastName, strlen(lastName));
+	size_t poolSlot = hash & (pool->capacity - 1);
+	const char *interned = NULL;
+	while (pool->entries[poolSlot].str != NULL) {
+		if (pool->entries[poolSlot].hash == hash && strcmp(pool->entries[poolSlot].str, lastName) == 0) {
+			interned = pool->entries[poolSlot].str;
+			break;
+		}
+		poolSlot = (poolSlot + 1) & (pool->capacity - 1);
+	}
+	if (interned == NULL) return -1;
+
+	size_t slot = hashPointer(interned) & (index->capacity - 1);
+	while (index->entries[slot].lastName != NULL) {
+		if (index->entries[slot].lastName == interned) {
+			return index->entries[slot].firstPerson;
+		}
+		slot = (slot + 1) & (index->capacity - 1);
+	}
+	return -1;
+}
+
+void freeLastNameIndex(LastNameIndex *index) {
+	free(index->entries);
+	free(index->nextWithSameLastName);
+}
+
+// Ages are small integers, so a counting sort builds the index in linear time
+AgeIndex buildAgeIndex(const PersonList *list) {
+	AgeIndex index;
+	size_t counts[MAX_AGE + 2] = {0};
+
+	index.count = list->count;
+	index.order = allocOrDie((list->count + 1) * sizeof(int));
+
+	for (size_t i = 0; i < list->count; i++) {
+		counts[list->people[i].age + 1]++;
+	}
+	for (int age = 1; age <= MAX_AGE + 1; age++) {
+		counts[age] += counts[age - 1];
+	}
+	for (size_t i = 0; i < list->count; i++) {
+		index.order[counts[list->people[i].age]++] = i;
+	}
+
+	return index;
+}
+
+// Position of the first person in the age index that is at least minAge years old
+size_t lowerBoundAge(const AgeIndex *index, const PersonList *list, int minAge) {
+	size_t low = 0;
+	size_t high = index->count;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (list->people[index->order[middle]].age < minAge) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+void freeAgeIndex(AgeIndex *index) {
+	free(index->order);
+}
+
+char exampleFirstNames[10][MAX_NAME_SZ] = {
+	"John", "Jane", "Alex", "Maria", "Peter", "Anna", "Lukas", "Sofia", "David", "Emma"
+};
+
+char exampleLastNames[10][MAX_NAME_SZ] = {
+	"Doe", "Foo", "Smith", "Miller", "Brown", "Wilson", "Taylor", "Clark", "Lewis", "Walker"
+};
+
+char exampleJobs[10][MAX_NAME_SZ] = {
+	"Software Developer", "Designer", "Teacher", "Nurse", "Carpenter",
+	"Chef", "Pilot", "Farmer", "Lawyer", "Musician"
+};
+
+// Write a CSV file with random people to benchmark the loader with
+void generateCsv(const char *path, long count) {
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	// Always the same people for the same count
+	srand(1);
+	for (long i = 0; i < count; i++) {
+		// Add a number to the last name so there are many distinct last names
+		fprintf(file, "%s,%s%d,%d,%s\n",
+			exampleFirstNames[rand() % 10],
+			exampleLastNames[rand() % 10], rand() % 1000,
+			rand() % 100,
+			exampleJobs[rand() % 10]);
+	}
+
+	fclose(file);
+}
+
+void benchmarkLoad(const char *path, const char *lastName, int minAge, int maxAge) {
+	PersonList list = createPersonList();
+
+	double startTime = getMonotonicSeconds();
+	size_t invalidLines = loadCsv(&list, path);
+	double loadTime = getMonotonicSeconds() - startTime;
+
+	startTime = getMonotonicSeconds();
+	LastNameIndex lastNameIndex = buildLastNameIndex(&list);
+	AgeIndex ageIndex = buildAgeIndex(&list);
+	double indexTime = getMonotonicSeconds() - startTime;
+
+	printf("Loaded %zu people (%zu invalid lines) in %.3f seconds\n", list.count, invalidLines, loadTime);
+	printf("Records/second: %.0f\n", list.count / loadTime);
+	printf("Distinct strings: %zu (%zu bytes)\n", list.pool.count, list.pool.arena.totalBytes);
+	printf("Built indices in %.3f seconds\n", indexTime);
+
+	if (lastName != NULL) {
+		size_t matches = 0;
+		int first = findByLastName(&lastNameIndex, &list.pool, lastName);
+		for (int i = first; i != -1; i = lastNameIndex.nextWithSameLastName[i]) {
+			matches++;
+		}
+		printf("People with last name %s: %zu\n", lastName, matches);
+		if (first != -1) {
+			printAboutMe(&list.people[first]);
+		}
+	}
+
+	if (minAge >= 0) {
+		size_t from = lowerBoundAge(&ageIndex, &list, minAge);
+		size_t to = lowerBoundAge(&ageIndex, &list, maxAge + 1);
+		printf("People aged %d to %d: %zu\n", minAge, maxAge, to - from);
+	}
+
+	freeAgeIndex(&ageIndex);
+	freeLastNameIndex(&lastNameIndex);
+	freePersonList(&list);
+}
+
+const char *getPersonString(const Person *person, int column) {
+	switch (column) {
+		case ColumnFirstName:
+			return person->firstName;
+		case ColumnLastName:
+			return person->lastName;
+		default:
+			return person->job;
+	}
+}
+
+// Pad the file with zeros so the next section starts 8 byte aligned
+uint64_t writeAlignedSection(FILE *file, uint64_t position, const void *data, size_t size) {
+	static const char zeros[8] = {0};
+
+	if (fwrite(data, 1, size, file) != size) {
+		fprintf(stderr, "Failed to write output.\n");
+		exit(EXIT_FAILURE);
+	}
+	position += size;
+
+	size_t padding = (8 - position % 8) % 8;
+	fwrite(zeros, 1, padding, file);
+	return position + padding;
+}
+
+// Write one string column: an offset per person followed by the blob of distinct strings
+uint64_t writeStringColumn(FILE *file, uint64_t position, const PersonList *list, int column, StringColumnHeader *header) {
+	uint32_t *offsets = allocOrDie((list->count + 1) * sizeof(uint32_t));
+	size_t blobSize = 0;
+	size_t blobCapacity = ARENA_BLOCK_SZ;
+	char *blob = allocOrDie(blobCapacity);
+
+	// Map from interned string to its offset in the blob, at most half full
+	size_t capacity = 16;
+	while (capacity < list->pool.count * 2) {
+		capacity *= 2;
+	}
+	const char **keys = calloc(capacity, sizeof(char *));
+	uint32_t *values = allocOrDie(capacity * sizeof(uint32_t));
+	if (keys == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < list->count; i++) {
+		const char *str = getPersonString(&list->people[i], column);
+
+		size_t slot = hashPointer(str) & (capacity - 1);
+		while (keys[slot] != NULL && keys[slot] != str) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+
+		// First time this string shows up in the column, add it to the blob
+		if (keys[slot] == NULL) {
+			size_t length = strlen(str) + 1;
+			while (blobSize + length > blobCapacity) {
+				blobCapacity *= 2;
+				blob = realloc(blob, blobCapacity);
+				if (blob == NULL) {
+					fprintf(stderr, "Memory allocation failed.\n");
+					exit(EXIT_FAILURE);
+				}
+			}
+			memcpy(blob + blobSize, str, length);
+			keys[slot] = str;
+			values[slot] = blobSize;
+			blobSize += length;
+		}
+		offsets[i] = values[slot];
+	}
+
+	header->offsetsStart = position;
+	position = writeAlignedSection(file, position, offsets, list->count * sizeof(uint32_t));
+	header->blobStart = position;
+	header->blobSize = blobSize;
+	position = writeAlignedSection(file, position, blob, blobSize);
+
+	free(keys);
+	free(values);
+	free(blob);
+	free(offsets);
+	return position;
+}
+
+// Convert a CSV file to the columnar binary format
+void convertCsv(const char *csvPath, const char *binaryPath) {
+	PersonList list = createPersonList();
+	size_t invalidLines = loadCsv(&list, csvPath);
+
+	FILE *file = fopen(binaryPath, "wb");
+	if (file == NULL) {
+		perror(binaryPath);
+		exit(EXIT_FAILURE);
+	}
+
+	PersonFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PERSON_FILE_MAGIC, 4);
+	header.version = PERSON_FILE_VERSION;
+	header.count = list.count;
+
+	// Write a placeholder header first, the positions are filled in once the columns are written
+	uint64_t position = writeAlignedSection(file, 0, &header, sizeof(header));
+
+	uint8_t *ages = allocOrDie(list.count + 1);
+	for (size_t i = 0; i < list.count; i++) {
+		ages[i] = list.people[i].age;
+	}
+	header.agesStart = position;
+	position = writeAlignedSection(file, position, ages, list.count);
+	free(ages);
+
+	for (int column = 0; column < STRING_COLUMN_COUNT; column++) {
+		position = writeStringColumn(file, position, &list, column, &header.columns[column]);
+	}
+
+	rewind(file);
+	fwrite(&header, 1, sizeof(header), file);
+	fclose(file);
+
+	printf("Converted %zu people (%zu invalid lines) into %llu bytes\n", list.count, invalidLines, (unsigned long long)position);
+	freePersonList(&list);
+}
+
+// Check that a section lies completely inside the file
+int isSectionInFile(uint64_t start, uint64_t size, size_t fileSize) {
+	return start <= fileSize && size <= fileSize - start;
+}
+
+// Map a binary person file into memory. Nothing is parsed or copied, only the header is checked.
+MappedPeople openMappedPeople(const char *path) {
+	MappedPeople mapped;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(PersonFileHeader)) {
+		fprintf(stderr, "%s is not a person file.\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	mapped.size = info.st_size;
+	mapped.base = mmap(NULL, mapped.size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped.base == MAP_FAILED) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	const PersonFileHeader *header = mapped.base;
+	const char *bytes = mapped.base;
+	if (memcmp(header->magic, PERSON_FILE_MAGIC, 4) != 0 || header->version != PERSON_FILE_VERSION) {
+		fprintf(stderr, "%s is not a person file.\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	mapped.count = header->count;
+	int isValid = header->count <= mapped.size && isSectionInFile(header->agesStart, header->count, mapped.size);
+	mapped.ages = (const uint8_t *)(bytes + header->agesStart);
+
+	for (int column = 0; column < STRING_COLUMN_COUNT; column++) {
+		const StringColumnHeader *columnHeader = &header->columns[column];
+
+		isValid = isValid &&
+			columnHeader->offsetsStart % 4 == 0 &&
+			isSectionInFile(columnHeader->offsetsStart, header->count * sizeof(uint32_t), mapped.size) &&
+			isSectionInFile(columnHeader->blobStart, columnHeader->blobSize, mapped.size) &&
+			// A null terminated last string means no string can run past the blob
+			(columnHeader->blobSize == 0 || bytes[columnHeader->blobStart + columnHeader->blobSize - 1] == '\0');
+
+		mapped.offsets[column] = (const uint32_t *)(bytes + columnHeader->offsetsStart);
+		mapped.blobs[column] = bytes + columnHeader->blobStart;
+		mapped.blobSizes[column] = columnHeader->blobSize;
+	}
+
+	if (!isValid) {
+		fprintf(stderr, "%s is corrupted.\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	return mapped;
+}
+
+const char *getMappedString(const MappedPeople *mapped, int column, size_t i) {
+	uint32_t offset = mapped->offsets[column][i];
+
+	// Offsets aren't checked on open, so guard against a corrupted one here
+	if (offset >= mapped->blobSizes[column]) return "";
+	return mapped->blobs[column] + offset;
+}
+
+// Look at a person in the mapped file, the strings point into the mapping
+Person getMappedPerson(const MappedPeople *mapped, size_t i) {
+	Person person;
+	person.firstName = getMappedString(mapped, ColumnFirstName, i);
+	person.lastName = getMappedString(mapped, ColumnLastName, i);
+	person.age = mapped->ages[i];
+	person.job = getMappedString(mapped, ColumnJob, i);
+	return person;
+}
+
+// Find the offset of a string in a column's blob, returns -1 if no person has it
+long findMappedString(const MappedPeople *mapped, int column, const char *str) {
+	const char *blob = mapped->blobs[column];
+	size_t position = 0;
+	while (position < mapped->blobSizes[column]) {
+		if (strcmp(blob + position, str) == 0) {
+			return position;
+		}
+		position += strlen(blob + position) + 1;
+	}
+	return -1;
+}
+
+void closeMappedPeople(MappedPeople *mapped) {
+	munmap(mapped->base, mapped->size);
+}
+
+void queryMapped(const char *path, const char *lastName, int minAge, int maxAge) {
+	double startTime = getMonotonicSeconds();
+	MappedPeople mapped = openMappedPeople(path);
+	double openTime = getMonotonicSeconds() - startTime;
+
+	printf("Opened %zu people in %.6f seconds\n", mapped.count, openTime);
+
+	if (lastName != NULL) {
+		long offset = findMappedString(&mapped, ColumnLastName, lastName);
+		const uint32_t *lastNames = mapped.offsets[ColumnLastName];
+		size_t matches = 0;
+		long first = -1;
+
+		// Scanning a single column of integers is all a lookup needs
+		if (offset >= 0) {
+			for (size_t i = 0; i < mapped.count; i++) {
+				if (lastNames[i] != (uint32_t)offset) continue;
+				if (first < 0) first = i;
+				matches++;
+			}
+		}
+
+		printf("People with last name %s: %zu\n", lastName, matches);
+		if (first >= 0) {
+			Person person = getMappedPerson(&mapped, first);
+			printAboutMe(&person);
+		}
+	}
+
+	if (minAge >= 0) {
+		size_t matches = 0;
+		for (size_t i = 0; i < mapped.count; i++) {
+			matches += mapped.ages[i] >= minAge && mapped.ages[i] <= maxAge;
+		}
+		printf("People aged %d to %d: %zu\n", minAge, maxAge, matches);
+	}
+
+	closeMappedPeople(&mapped);
+}
+
+// Compare how long it takes until the first person can be used with either format
+void compareStartup(const char *csvPath, const char *binaryPath) {
+	double startTime = getMonotonicSeconds();
+	PersonList list = createPersonList();
+	loadCsv(&list, csvPath);
+	double csvTime = getMonotonicSeconds() - startTime;
+
+	startTime = getMonotonicSeconds();
+	MappedPeople mapped = openMappedPeople(binaryPath);
+	// Reading the first person is part of the startup, but an empty file has none
+	Person first = {0};
+	if (mapped.count > 0) {
+		first = getMappedPerson(&mapped, 0);
+	}
+	double mappedTime = getMonotonicSeconds() - startTime;
+
+	printf("CSV load:    %zu people in %.6f seconds\n", list.count, csvTime);
+	printf("Mapped open: %zu people in %.6f seconds\n", mapped.count, mappedTime);
+	printf("Speedup: %.0fx\n", csvTime / mappedTime);
+	if (mapped.count > 0) {
+		printAboutMe(&first);
+	}
+
+	closeMappedPeople(&mapped);
+	freePersonList(&list);
+}
+
+// The same sentences as printAboutMe and printAboutYou
+const char *aboutMeTemplate = "My name is {firstName} {lastName}, I am {age} years old and I work as a {job}.\n";
+const char *aboutYouTemplate = "Your name is {firstName} {lastName}, you are {age} years old and you work as a {job}.\n";
+
+const char *fieldNames[] = {"firstName", "lastName", "job", "age"};
+
+// Split a template like "Hi {firstName}!" into literal segments and field slots
+SentenceTemplate compileTemplate(const char *pattern) {
+	SentenceTemplate sentence;
+	sentence.count = 0;
+
+	const char *cursor = pattern;
+	while (*cursor != '\0') {
+		if (sentence.count == MAX_TEMPLATE_SEGMENTS) {
+			fprintf(stderr, "Template has too many segments.\n");
+			exit(EXIT_FAILURE);
+		}
+		TemplateSegment *segment = &sentence.segments[sentence.count++];
+
+		if (*cursor != '{') {
+			// Everything up to the next slot is literal text
+			const char *slot = strchr(cursor, '{');
+			segment->field = SegmentLiteral;
+			segment->text = cursor;
+			segment->length = slot != NULL ? (size_t)(slot - cursor) : strlen(cursor);
+			cursor += segment->length;
+			continue;
+		}
+
+		const char *close = strchr(cursor, '}');
+		segment->field = SegmentLiteral;
+		for (int field = 0; close != NULL && field <= FieldAge; field++) {
+			if (strlen(fieldNames[field]) == (size_t)(close - cursor - 1) && strncmp(cursor + 1, fieldNames[field], close - cursor - 1) == 0) {
+				segment->field = field;
+			}
+		}
+		if (segment->field == SegmentLiteral) {
+			fprintf(stderr, "Unknown field in template: %s\n", cursor);
+			exit(EXIT_FAILURE);
+		}
+		cursor = close + 1;
+	}
+
+	return sentence;
+}
+
+void reserveText(TextBuffer *buffer, size_t extra) {
+	if (buffer->length + extra <= buffer->capacity) return;
+
+	while (buffer->length + extra > buffer->capacity) {
+		buffer->capacity = buffer->capacity > 0 ? buffer->capacity * 2 : OUTPUT_FLUSH_SZ;
+	}
+	buffer->data = realloc(buffer->data, buffer->capacity);
+	if (buffer->data == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Write a non-negative number two digits at a time, returns the amount of characters written
+size_t formatUnsigned(char *out, unsigned int value) {
+	static const char digitPairs[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+	char digits[10];
+	int position = 10;
+
+	while (value >= 100) {
+		unsigned int pair = value % 100;
+		value /= 100;
+		position -= 2;
+		memcpy(digits + position, digitPairs + pair * 2, 2);
+	}
+	if (value >= 10) {
+		position -= 2;
+		memcpy(digits + position, digitPairs + value * 2, 2);
+	} else {
+		digits[--position] = '0' + value;
+	}
+
+	memcpy(out, digits + position, 10 - position);
+	return 10 - position;
+}
+
+// Append the sentence for one person to the buffer
+void formatPerson(TextBuffer *buffer, const SentenceTemplate *sentence, const Person *person) {
+	const char *strings[STRING_COLUMN_COUNT];
+	size_t lengths[STRING_COLUMN_COUNT];
+	size_t total = 10;
+
+	// Measure the whole sentence first so there is only one capacity check
+	for (int column = 0; column < STRING_COLUMN_COUNT; column++) {
+		strings[column] = getPersonString(person, column);
+		lengths[column] = strlen(strings[column]);
+	}
+	for (int i = 0; i < sentence->count; i++) {
+		int field = sentence->segments[i].field;
+		if (field == SegmentLiteral) {
+			total += sentence->segments[i].length;
+		} else if (field != FieldAge) {
+			total += lengths[field];
+		}
+	}
+	reserveText(buffer, total);
+
+	char *out = buffer->data + buffer->length;
+	for (int i = 0; i < sentence->count; i++) {
+		const TemplateSegment *segment = &sentence->segments[i];
+		if (segment->field == SegmentLiteral) {
+			memcpy(out, segment->text, segment->length);
+			out += segment->length;
+		} else if (segment->field == FieldAge) {
+			out += formatUnsigned(out, person->age);
+		} else {
+			memcpy(out, strings[segment->field], lengths[segment->field]);
+			out += lengths[segment->field];
+		}
+	}
+	buffer->length = out - buffer->data;
+}
+
+void writeAll(int fd, const char *data, size_t length) {
+	while (length > 0) {
+		ssize_t written = write(fd, data, length);
+		if (written < 0) {
+			perror("write");
+			exit(EXIT_FAILURE);
+		}
+		data += written;
+		length -= written;
+	}
+}
+
+void *runFormatJob(void *argument) {
+	FormatJob *job = argument;
+	for (size_t i = 0; i < job->count; i++) {
+		formatPerson(job->buffer, job->sentence, &job->people[i]);
+	}
+	return NULL;
+}
+
+// Format the sentences for all people and write them to fd in large writes.
+// With more than one thread, every round each thread formats its own batch and the batches are written in order.
+void formatPeople(int fd, const SentenceTemplate *sentence, const Person *people, size_t count, int threadCount) {
+	TextBuffer buffers[MAX_THREADS];
+	memset(buffers, 0, sizeof(buffers));
+
+	if (threadCount <= 1) {
+		for (size_t i = 0; i < count; i++) {
+			formatPerson(&buffers[0], sentence, &people[i]);
+			if (buffers[0].length >= OUTPUT_FLUSH_SZ) {
+				writeAll(fd, buffers[0].data, buffers[0].length);
+				buffers[0].length = 0;
+			}
+		}
+		writeAll(fd, buffers[0].data, buffers[0].length);
+		free(buffers[0].data);
+		return;
+	}
+
+	pthread_t threads[MAX_THREADS];
+	FormatJob jobs[MAX_THREADS];
+	size_t next = 0;
+
+	while (next < count) {
+		int started = 0;
+		for (; started < threadCount && next < count; started++) {
+			size_t batch = count - next < FORMAT_BATCH_SZ ? count - next : FORMAT_BATCH_SZ;
+			jobs[started].sentence = sentence;
+			jobs[started].people = people + next;
+			jobs[started].count = batch;
+			jobs[started].buffer = &buffers[started];
+			buffers[started].length = 0;
+			pthread_create(&threads[started], NULL, runFormatJob, &jobs[started]);
+			next += batch;
+		}
+
+		// Waiting in thread order keeps the output in the same order as the people
+		for (int i = 0; i < started; i++) {
+			pthread_join(threads[i], NULL);
+			writeAll(fd, buffers[i].data, buffers[i].length);
+		}
+	}
+
+	for (int i = 0; i < threadCount; i++) {
+		free(buffers[i].data);
+	}
+}
+
+// Format all people from a CSV file to stdout with the template or with printf
+void formatCsv(const char *path, int isAboutYou, int threadCount, int usePrintf) {
+	PersonList list = createPersonList();
+	loadCsv(&list, path);
+
+	SentenceTemplate sentence = compileTemplate(isAboutYou ? aboutYouTemplate : aboutMeTemplate);
+
+	double startTime = getMonotonicSeconds();
+	if (usePrintf) {
+		for (size_t i = 0; i < list.count; i++) {
+			if (isAboutYou) {
+				printAboutYou(&list.people[i]);
+			} else {
+				printAboutMe(&list.people[i]);
+			}
+		}
+		fflush(stdout);
+	} else {
+		fflush(stdout);
+		formatPeople(STDOUT_FILENO, &sentence, list.people, list.count, threadCount);
+	}
+	double elapsed = getMonotonicSeconds() - startTime;
+
+	// Report on stderr so the sentences can be redirected
+	fprintf(stderr, "Formatted %zu people with %s in %.3f seconds\n", list.count, usePrintf ? "printf" : "the template", elapsed);
+	fprintf(stderr, "Records/second: %.0f\n", list.count / elapsed);
+
+	freePersonList(&list);
 }
 
 char* removeTrailingNewLine(char str[]) {
 	int lastChar = strlen(str) - 1;
 
 	// If the last character is a new line, replace it with a null terminator
-	if (str[lastChar] == '\n') {
+	if (lastChar >= 0 && str[lastChar] == '\n') {
 		str[lastChar] = '\0';
 	}
 	return str;
 }
 
-char* receiveInput(char nameType[]) {\
-	// Allocate memory for the input
-	char *input = malloc(MAX_NAME_SZ);
-
+char* receiveInput(char nameType[], char input[]) {
 	// Ask for the input
 	printf("Enter your %s: ", nameType);
 
 	// Read the input
-	fgets(input, MAX_NAME_SZ, stdin);
+	if (fgets(input, MAX_NAME_SZ, stdin) == NULL) {
+		input[0] = '\0';
+	}
 
 	// Remove the trailing new line
-	input = removeTrailingNewLine(input);
-
-	return input;
+	return removeTrailingNewLine(input);
 }
 
-int main() {
+void runInteractive() {
+	StringPool pool = createStringPool();
+
 	// Example of creating a person
-	Person john = createPerson("John", "Doe", "30", "Software Developer");
-	printAboutMe(john);
+	Person john = createPerson(&pool, "John", "Doe", 30, "Software Developer");
+	printAboutMe(&john);
 
-	Person jane = createPerson("Jane", "Foo", "25", "Designer");
-	printAboutMe(jane);
+	Person jane = createPerson(&pool, "Jane", "Foo", 25, "Designer");
+	printAboutMe(&jane);
 
 	// Now it's the users turn
 	printf("What about you?\n");
 
-	char* firstName = receiveInput("first name");
+	char firstName[MAX_NAME_SZ];
+	receiveInput("first name", firstName);
+
+	char lastName[MAX_NAME_SZ];
+	receiveInput("last name", lastName);
+
+	char age[MAX_NAME_SZ];
+	receiveInput("age", age);
+
+	char job[MAX_NAME_SZ];
+	receiveInput("job", job);
+
+	Person you = createPerson(&pool, firstName, lastName, atoi(age), job);
+
+	printAboutYou(&you);
+
+	freeStringPool(&pool);
+}
+
+void printUsage(const char *program) {
+	fprintf(stderr, "Usage: %s [command]\n", program);
+	fprintf(stderr, "  --generate FILE N                Write N random people to a CSV file\n");
+	fprintf(stderr, "  --load FILE [--last-name NAME] [--age MIN MAX]\n");
+	fprintf(stderr, "                                   Load a CSV file, report records/second and query it\n");
+	fprintf(stderr, "  --convert CSV FILE               Convert a CSV file to the columnar binary format\n");
+	fprintf(stderr, "  --open FILE [--last-name NAME] [--age MIN MAX]\n");
+	fprintf(stderr, "                                   Map a binary file and query it in place\n");
+	fprintf(stderr, "  --compare CSV FILE               Compare the startup time of both formats\n");
+	fprintf(stderr, "  --format CSV [--you] [--threads N] [--printf]\n");
+	fprintf(stderr, "                                   Print a sentence for every person and report records/second\n");
+}
+
+int main(int argc, char *argv[]) {
+	if (argc == 1) {
+		runInteractive();
+		return 0;
+	}
+
+	if (strcmp(argv[1], "--generate") == 0 && argc == 4) {
+		generateCsv(argv[2], atol(argv[3]));
+		return 0;
+	}
+
+	if (strcmp(argv[1], "--convert") == 0 && argc == 4) {
+		convertCsv(argv[2], argv[3]);
+		return 0;
+	}
 
-	char* lastName = receiveInput("last name");
+	if (strcmp(argv[1], "--compare") == 0 && argc == 4) {
+		compareStartup(argv[2], argv[3]);
+		return 0;
+	}
+
+	if (strcmp(argv[1], "--format") == 0 && argc >= 3) {
+		int isAboutYou = 0, threadCount = 1, usePrintf = 0;
 
-	char* age = receiveInput("age");
+		for (int i = 3; i < argc; i++) {
+			if (strcmp(argv[i], "--you") == 0) {
+				isAboutYou = 1;
+			} else if (strcmp(argv[i], "--printf") == 0) {
+				usePrintf = 1;
+			} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+				threadCount = atoi(argv[++i]);
+				if (threadCount < 1 || threadCount > MAX_THREADS) {
+					fprintf(stderr, "Thread count must be between 1 and %d.\n", MAX_THREADS);
+					return 1;
+				}
+			} else {
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
 
-	char* job = receiveInput("job");
+		formatCsv(argv[2], isAboutYou, threadCount, usePrintf);
+		return 0;
+	}
 
-	Person you = createPerson(firstName, lastName, age, job);
+	if ((strcmp(argv[1], "--load") == 0 || strcmp(argv[1], "--open") == 0) && argc >= 3) {
+		const char *lastName = NULL;
+		int minAge = -1, maxAge = -1;
 
-	printAboutYou(you);
+		for (int i = 3; i < argc; i++) {
+			if (strcmp(argv[i], "--last-name") == 0 && i + 1 < argc) {
+				lastName = argv[++i];
+			} else if (strcmp(argv[i], "--age") == 0 && i + 2 < argc) {
+				minAge = atoi(argv[++i]);
+				maxAge = atoi(argv[++i]);
+				if (minAge < 0 || maxAge > MAX_AGE || minAge > maxAge) {
+					fprintf(stderr, "Ages must be between 0 and %d, with MIN not above MAX.\n", MAX_AGE);
+					return 1;
+				}
+			} else {
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+
+		if (strcmp(argv[1], "--load") == 0) {
+			benchmarkLoad(argv[2], lastName, minAge, maxAge);
+		} else {
+			queryMapped(argv[2], lastName, minAge, maxAge);
+		}
+		return 0;
+	}
 
-	return 0;
+	printUsage(argv[0]);
+	return 1;
 }
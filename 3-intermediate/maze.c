@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <time.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 // Define colors for the terminal
 #define KNRM "\x1B[0m"  // Reset color
@@ -150,6 +153,172 @@ void renderField() {
     }
 }
 
+// Aim for chunks of about this many bytes of output
+#define CHUNK_TARGET_SZ (1 << 20)
+
+// Amount of chunks that can be encoded ahead of the writer
+#define CHUNK_SLOTS_PER_THREAD 2
+
+#define MAX_RENDER_THREADS 64
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int chunk;      // Chunk the slot belongs to, slot i holds chunks i, i + slot_count, ...
+    bool is_ready;  // Whether that chunk is fully encoded
+} ChunkSlot;
+
+// Shared state of the workers and the writer
+typedef struct {
+    ChunkSlot *slots;
+    int slot_count;
+    int chunk_count;
+    int rows_per_chunk;
+    int next_chunk;
+    pthread_mutex_t lock;
+    pthread_cond_t slot_freed;
+    pthread_cond_t chunk_ready;
+} RenderPipeline;
+
+// Encode the rows from start_y up to end_y exactly like renderField prints them
+void encodeRows(ChunkSlot *slot, int start_y, int end_y) {
+    // The textures never change while rendering, so measure them once
+    const char *textures[4];
+    size_t lengths[4];
+    for (int tile = Wall; tile <= Branch; tile++) {
+        textures[tile] = getTileTexture(tile);
+        lengths[tile] = strlen(textures[tile]);
+    }
+
+    size_t longest = lengths[Wall] > lengths[Solution] ? lengths[Wall] : lengths[Solution];
+    size_t needed = (size_t)(end_y - start_y) * (field.width * longest + 1);
+    if (needed > slot->capacity) {
+        free(slot->data);
+        slot->data = malloc(needed);
+        slot->capacity = needed;
+        if (slot->data == NULL) {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    char *out = slot->data;
+    for (int y = start_y; y < end_y; y++) {
+        const int *row = field.data[y];
+        for (int x = 0; x < field.width; x++) {
+            memcpy(out, textures[row[x]], lengths[row[x]]);
+            out += lengths[row[x]];
+        }
+        *out++ = '\n';
+    }
+    slot->length = out - slot->data;
+}
+
+void *runRenderWorker(void *argument) {
+    RenderPipeline *pipeline = argument;
+
+    pthread_mutex_lock(&pipeline->lock);
+    while (pipeline->next_chunk < pipeline->chunk_count) {
+        int chunk = pipeline->next_chunk++;
+        ChunkSlot *slot = &pipeline->slots[chunk % pipeline->slot_count];
+
+        // Wait until the writer is done with the chunk that used this slot before
+        while (slot->chunk != chunk) {
+            pthread_cond_wait(&pipeline->slot_freed, &pipeline->lock);
+        }
+        pthread_mutex_unlock(&pipeline->lock);
+
+        // Encoding happens without the lock, in parallel with the other workers and the writer
+        int start_y = chunk * pipeline->rows_per_chunk;
+        int end_y = start_y + pipeline->rows_per_chunk < field.height ? start_y + pipeline->rows_per_chunk : field.height;
+        encodeRows(slot, start_y, end_y);
+
+        pthread_mutex_lock(&pipeline->lock);
+        slot->is_ready = true;
+        pthread_cond_broadcast(&pipeline->chunk_ready);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return NULL;
+}
+
+void writeAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+// Render the field with worker threads encoding chunks of rows while this thread writes finished chunks in order.
+// The output is byte for byte the same as renderField.
+void renderFieldParallel(int thread_count) {
+    RenderPipeline pipeline;
+    pthread_t threads[MAX_RENDER_THREADS];
+
+    // Make sure everything printed before ends up before the maze
+    fflush(stdout);
+
+    pipeline.rows_per_chunk = CHUNK_TARGET_SZ / (field.width * 11 + 1);
+    if (pipeline.rows_per_chunk < 1) {
+        pipeline.rows_per_chunk = 1;
+    }
+    pipeline.chunk_count = (field.height + pipeline.rows_per_chunk - 1) / pipeline.rows_per_chunk;
+    pipeline.slot_count = thread_count * CHUNK_SLOTS_PER_THREAD;
+    pipeline.next_chunk = 0;
+    pipeline.slots = calloc(pipeline.slot_count, sizeof(ChunkSlot));
+    if (pipeline.slots == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < pipeline.slot_count; i++) {
+        pipeline.slots[i].chunk = i;
+    }
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.slot_freed, NULL);
+    pthread_cond_init(&pipeline.chunk_ready, NULL);
+
+    for (int i = 0; i < thread_count; i++) {
+        pthread_create(&threads[i], NULL, runRenderWorker, &pipeline);
+    }
+
+    // Write the chunks in row order as soon as each one is ready
+    for (int chunk = 0; chunk < pipeline.chunk_count; chunk++) {
+        ChunkSlot *slot = &pipeline.slots[chunk % pipeline.slot_count];
+
+        pthread_mutex_lock(&pipeline.lock);
+        while (!slot->is_ready) {
+            pthread_cond_wait(&pipeline.chunk_ready, &pipeline.lock);
+        }
+        pthread_mutex_unlock(&pipeline.lock);
+
+        writeAll(STDOUT_FILENO, slot->data, slot->length);
+
+        pthread_mutex_lock(&pipeline.lock);
+        // Hand the slot over to the chunk that comes a whole ring later
+        slot->chunk = chunk + pipeline.slot_count;
+        slot->is_ready = false;
+        pthread_cond_broadcast(&pipeline.slot_freed);
+        pthread_mutex_unlock(&pipeline.lock);
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < pipeline.slot_count; i++) {
+        free(pipeline.slots[i].data);
+    }
+    free(pipeline.slots);
+    pthread_mutex_destroy(&pipeline.lock);
+    pthread_cond_destroy(&pipeline.slot_freed);
+    pthread_cond_destroy(&pipeline.chunk_ready);
+}
+
 // Function to free the allocated memory for the Field
 void freeField() {
     for (int y = 0; y < field.height; y++) {
@@ -318,27 +487,58 @@ void lookForPotentialBranches() {
     }
 }
 
-int main() {
+int main(int argc, char *argv[]) {
     // Seed the random number generator
-    srand(time(NULL));
+    unsigned int seed = time(NULL);
+
+    // With --rows and --cols the maze is generated without asking anything
+    int rows = -1, cols = -1;
+    show_solution = false;
+    bool is_serial = false;
+    int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            rows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cols") == 0 && i + 1 < argc) {
+            cols = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--solution") == 0) {
+            show_solution = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--serial") == 0) {
+            is_serial = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--rows R --cols C [--seed S] [--solution]] [--threads N | --serial]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (thread_count < 1) {
+        thread_count = 1;
+    } else if (thread_count > MAX_RENDER_THREADS) {
+        thread_count = MAX_RENDER_THREADS;
+    }
+    bool is_headless = rows > 0 && cols > 0;
+
+    srand(seed);
 
     // Start the timer to measure the time taken
     float start_time = (float)clock() / CLOCKS_PER_SEC;
 
-
-    printf(KGRE "Maze Generator!\n\n" KNRM);
-
-
-    // Ask user for row and column count and whether to show the solution or not
-    int rows, cols;
-    printf("Enter amount of rows: ");
-    scanf("%d", &rows);
-    printf("Enter amount of columns: ");
-    scanf("%d", &cols);
-    printf("Show solution? [y/n]: ");
-    char show_solution_input;
-    scanf(" %c", &show_solution_input);
-    show_solution = show_solution_input == 'y';
+    if (!is_headless) {
+        printf(KGRE "Maze Generator!\n\n" KNRM);
+
+        // Ask user for row and column count and whether to show the solution or not
+        printf("Enter amount of rows: ");
+        scanf("%d", &rows);
+        printf("Enter amount of columns: ");
+        scanf("%d", &cols);
+        printf("Show solution? [y/n]: ");
+        char show_solution_input;
+        scanf(" %c", &show_solution_input);
+        show_solution = show_solution_input == 'y';
+    }
 
     // Generate the field
     generateField(rows, cols);
@@ -362,10 +562,14 @@ int main() {
     float end_time = (float)clock() / CLOCKS_PER_SEC;
 
     // Render the field to the terminal
-    renderField();
+    if (is_serial) {
+        renderField();
+    } else {
+        renderFieldParallel(thread_count);
+    }
 
-    // Print the time taken
-    printf("Time taken: %f seconds\n", end_time - start_time);
+    // Print the time taken, on stderr when headless so stdout only has the maze
+    fprintf(is_headless ? stderr : stdout, "Time taken: %f seconds\n", end_time - start_time);
 
     // Free the allocated emory for the Field
     freeField();
@@ -1,3 +1,3 @@
 # Example ./run.sh helloworld.c
-gcc $1
+gcc $1 -pthread
 ./a.out
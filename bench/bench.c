@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define MAX_TRIALS 1000
+#define MAX_PATH_SZ 1024
+
+// Amount of pairs and people in the generated inputs
+#define CALCULATOR_PAIRS 1000000
+#define PEOPLE_COUNT "1000000"
+
+// One game of rpg is over in well under a millisecond, so play enough to outweigh starting the process
+#define RPG_GAMES 1000
+#define RPG_GAMES_TEXT "1000"
+
+typedef struct {
+	const char *name;
+	// Name of the compiled program in the build directory
+	const char *program;
+	const char *args[8];
+	// File in the build directory that is sent to stdin, or NULL for /dev/null
+	const char *input;
+	// Amount of work one run does, for the throughput
+	double items;
+	const char *unit;
+} Benchmark;
+
+typedef struct {
+	int trials;
+	double median;
+	double p99;
+	double min;
+	double max;
+	long peakRssKb;
+	bool hasFailed;
+} Result;
+
+// Every program runs headless with a fixed seed and all output going to /dev/null
+Benchmark benchmarks[] = {
+	{"donut", "donut", {"--frames", "100", NULL}, NULL, 100, "frames"},
+	{"road", "road", {"--frames", "1000000", NULL}, NULL, 1000000, "frames"},
+	{"maze", "maze", {"--rows", "300", "--cols", "300", "--seed", "1", NULL}, NULL, 300 * 300, "cells"},
+	{"rpg", "rpg", {"--headless", "--seed", "1", "--games", RPG_GAMES_TEXT, NULL}, NULL, RPG_GAMES, "games"},
+	{"calculator", "calculator", {"--batch", NULL}, "calculator-pairs.txt", CALCULATOR_PAIRS, "pairs"},
+	{"struct-load", "struct", {"--load", "people.csv", NULL}, NULL, 1000000, "records"},
+	{"struct-format", "struct", {"--format", "people.csv", NULL}, NULL, 1000000, "records"},
+};
+
+#define BENCHMARK_COUNT (int)(sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+double getMonotonicSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Run a program once in the build directory, returns the wall time or -1 if it failed
+double runOnce(const char *directory, const Benchmark *benchmark, long *peakRssKb) {
+	char path[MAX_PATH_SZ];
+	snprintf(path, sizeof(path), "./%s", benchmark->program);
+
+	const char *argv[10];
+	argv[0] = path;
+	int argc = 1;
+	for (int i = 0; benchmark->args[i] != NULL; i++) {
+		argv[argc++] = benchmark->args[i];
+	}
+	argv[argc] = NULL;
+
+	double startTime = getMonotonicSeconds();
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+
+	if (pid == 0) {
+		// Inputs are relative to the build directory, and all output is thrown away
+		if (chdir(directory) < 0) {
+			perror(directory);
+			_exit(127);
+		}
+		int input = open(benchmark->input != NULL ? benchmark->input : "/dev/null", O_RDONLY);
+		int sink = open("/dev/null", O_WRONLY);
+		if (input < 0 || sink < 0) {
+			perror(benchmark->name);
+			_exit(127);
+		}
+		dup2(input, STDIN_FILENO);
+		dup2(sink, STDOUT_FILENO);
+		dup2(sink, STDERR_FILENO);
+		execv(path, (char *const *)argv);
+		_exit(127);
+	}
+
+	int status;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) < 0) {
+		perror("wait4");
+		exit(EXIT_FAILURE);
+	}
+	double elapsed = getMonotonicSeconds() - startTime;
+
+	// On Linux ru_maxrss is in kilobytes
+	if (usage.ru_maxrss > *peakRssKb) {
+		*peakRssKb = usage.ru_maxrss;
+	}
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+	return elapsed;
+}
+
+int compareDoubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+Result runBenchmark(const char *directory, const Benchmark *benchmark, int warmup, int trials) {
+	Result result;
+	double times[MAX_TRIALS];
+	memset(&result, 0, sizeof(result));
+
+	// Warm up the page cache and CPU frequency, these runs aren't counted
+	for (int i = 0; i < warmup; i++) {
+		long ignored = 0;
+		if (runOnce(directory, benchmark, &ignored) < 0) {
+			result.hasFailed = true;
+			return result;
+		}
+	}
+
+	for (int i = 0; i < trials; i++) {
+		times[i] = runOnce(directory, benchmark, &result.peakRssKb);
+		if (times[i] < 0) {
+			result.hasFailed = true;
+			return result;
+		}
+	}
+
+	qsort(times, trials, sizeof(double), compareDoubles);
+	result.trials = trials;
+	result.min = times[0];
+	result.max = times[trials - 1];
+	result.median = trials % 2 == 1 ? times[trials / 2] : (times[trials / 2 - 1] + times[trials / 2]) / 2;
+
+	// Nearest rank, the smallest time that at least 99% of the trials are below or equal to
+	int rank = (99 * trials + 99) / 100;
+	result.p99 = times[rank - 1];
+	return result;
+}
+
+// Create the inputs some of the programs read, always the same for every build
+void prepareInputs(const char *directory) {
+	char path[MAX_PATH_SZ];
+
+	snprintf(path, sizeof(path), "%s/calculator-pairs.txt", directory);
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	srand(1);
+	for (int i = 0; i < CALCULATOR_PAIRS; i++) {
+		fprintf(file, "%d %d\n", rand() - RAND_MAX / 2, rand() % 2001 - 1000);
+	}
+	fclose(file);
+
+	Benchmark generator = {"people", "struct", {"--generate", "people.csv", PEOPLE_COUNT, NULL}, NULL, 0, ""};
+	long ignored = 0;
+	if (runOnce(directory, &generator, &ignored) < 0) {
+		fprintf(stderr, "Failed to generate people.csv with %s/struct.\n", directory);
+		exit(EXIT_FAILURE);
+	}
+}
+
+void printJson(const Benchmark *selected[], const Result results[], int count) {
+	printf("[\n");
+	for (int i = 0; i < count; i++) {
+		const Result *result = &results[i];
+		printf("  {\"name\": \"%s\", ", selected[i]->name);
+		if (result->hasFailed) {
+			printf("\"failed\": true}");
+		} else {
+			printf("\"trials\": %d, \"median_seconds\": %.6f, \"p99_seconds\": %.6f, \"min_seconds\": %.6f, \"max_seconds\": %.6f, "
+				"\"throughput\": %.1f, \"unit\": \"%s/s\", \"peak_rss_kb\": %ld}",
+				result->trials, result->median, result->p99, result->min, result->max,
+				selected[i]->items / result->median, selected[i]->unit, result->peakRssKb);
+		}
+		printf(i + 1 < count ? ",\n" : "\n");
+	}
+	printf("]\n");
+}
+
+void printCsv(const Benchmark *selected[], const Result results[], int count) {
+	printf("name,trials,median_seconds,p99_seconds,min_seconds,max_seconds,throughput,unit,peak_rss_kb,failed\n");
+	for (int i = 0; i < count; i++) {
+		const Result *result = &results[i];
+		if (result->hasFailed) {
+			printf("%s,,,,,,,,,1\n", selected[i]->name);
+			continue;
+		}
+		printf("%s,%d,%.6f,%.6f,%.6f,%.6f,%.1f,%s/s,%ld,0\n",
+			selected[i]->name, result->trials, result->median, result->p99, result->min, result->max,
+			selected[i]->items / result->median, selected[i]->unit, result->peakRssKb);
+	}
+}
+
+void printUsage(const char *program) {
+	fprintf(stderr, "Usage: %s BUILD_DIR [--trials N] [--warmup N] [--csv] [--only NAME]\n", program);
+	fprintf(stderr, "Runs every program in BUILD_DIR headless and prints a JSON report.\n");
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	const char *directory = argv[1];
+	int trials = 5;
+	int warmup = 1;
+	bool isCsv = false;
+	const char *only = NULL;
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc) {
+			trials = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			warmup = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--csv") == 0) {
+			isCsv = true;
+		} else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+			only = argv[++i];
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (trials < 1 || trials > MAX_TRIALS || warmup < 0) {
+		fprintf(stderr, "Trials must be between 1 and %d.\n", MAX_TRIALS);
+		return 1;
+	}
+
+	// Check the name before the inputs are generated, an empty report would look like a passing run
+	if (only != NULL) {
+		bool isKnown = false;
+		for (int i = 0; i < BENCHMARK_COUNT; i++) {
+			isKnown = isKnown || strcmp(only, benchmarks[i].name) == 0;
+		}
+		if (!isKnown) {
+			fprintf(stderr, "Unknown benchmark '%s', the names are:", only);
+			for (int i = 0; i < BENCHMARK_COUNT; i++) {
+				fprintf(stderr, " %s", benchmarks[i].name);
+			}
+			fprintf(stderr, "\n");
+			return 1;
+		}
+	}
+
+	prepareInputs(directory);
+
+	const Benchmark *selected[BENCHMARK_COUNT];
+	Result results[BENCHMARK_COUNT];
+	int count = 0;
+
+	for (int i = 0; i < BENCHMARK_COUNT; i++) {
+		if (only != NULL && strcmp(only, benchmarks[i].name) != 0) continue;
+
+		// Progress goes to stderr so the report can be redirected to a file
+		fprintf(stderr, "Running %s...\n", benchmarks[i].name);
+		selected[count] = &benchmarks[i];
+		results[count] = runBenchmark(directory, &benchmarks[i], warmup, trials);
+		count++;
+	}
+
+	if (isCsv) {
+		printCsv(selected, results, count);
+	} else {
+		printJson(selected, results, count);
+	}
+
+	for (int i = 0; i < count; i++) {
+		if (results[i].hasFailed) return 1;
+	}
+	return 0;
+}
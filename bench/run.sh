@@ -0,0 +1,11 @@
+# Example ./run.sh --trials 5 > report.json
+# Builds every program with the same flags and runs them all headless
+mkdir -p build
+gcc -O2 ../1-basics/calculator.c -o build/calculator -lm
+gcc -O2 ../2-beginner/donut.c -o build/donut -lm
+gcc -O2 ../2-beginner/road.c -o build/road -lm
+gcc -O2 ../2-beginner/rpg.c -o build/rpg
+gcc -O2 ../2-beginner/struct.c -o build/struct -pthread
+gcc -O2 ../3-intermediate/maze.c -o build/maze -pthread
+gcc -O2 bench.c -o build/bench
+./build/bench build "$@"